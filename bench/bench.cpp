@@ -0,0 +1,269 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <regex>
+#include <unistd.h>
+#include <opencv2/opencv.hpp>
+#include "pimg/bmp.h"
+#include "pimg/grid.h"
+#include "pimg/integral.h"
+#include "pimg/metrics.h"
+#include "hash/phash.h"
+#include "hash/hamming.h"
+#include "hash/engine.h"
+using namespace std;
+
+#define DEFAULT_MIN_STAGE_SECONDS 0.25
+#define DEFAULT_MAX_SYNTHETIC_SIZE 4096 // 16384 needs over 5 GB (opt in with --max-size)
+#define COMPARE_BATCH_SIZE 100000
+
+typedef struct {
+    string image;
+    string stage;
+    size_t iterations;
+    double seconds; // mean seconds per iteration
+    double throughput;
+    string unit;
+} BenchResult;
+
+static const char* kernelNames[] = {"scalar", "popcnt", "avx2", "avx512"};
+
+class StageBenchmark {
+    public:
+        StageBenchmark(const double minStageSeconds) : minStageSeconds(minStageSeconds) {}
+        void runImage(const string& label, const cv::Mat& image);
+        void runCompare(void);
+        void printResults(ostream& out) const;
+        void writeJSON(ostream& out) const;
+
+    private:
+        template <typename F> void timeStage(const string& image, const string& stage, 
+            const double workPerIteration, const string& unit, F stageFunction);
+
+        static GridPixel reduceBlockMeans(const IntegralGrid& integralGrid, PixelGrid& normalizedGrid);
+
+        const double minStageSeconds;
+        vector<BenchResult> results;
+};
+
+/*
+ * Repeats stage until the minimum stage time elapses and records mean time.
+ */
+template <typename F>
+void StageBenchmark::timeStage(const string& image, const string& stage, 
+    const double workPerIteration, const string& unit, F stageFunction) {
+    size_t iterations = 0;
+    const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    double elapsed = 0;
+    do {
+        stageFunction();
+        iterations++;
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while (elapsed < minStageSeconds);
+    const double seconds = elapsed / iterations;
+    results.push_back({image, stage, iterations, seconds, workPerIteration / seconds, unit});
+}
+
+/*
+ * Reduces the image into a normalized grid from summed-area block means and
+ * returns the image mean (a stand-in for the private normalization; the 
+ * executeHash stages time the production path).
+ */
+GridPixel StageBenchmark::reduceBlockMeans(const IntegralGrid& integralGrid, PixelGrid& normalizedGrid) {
+    const uint32_t dimension = normalizedGrid.getGridHeight();
+    vector<size_t> rowBoundaries, columnBoundaries;
+    ImagePerceptualHash::computeBlockBoundaries(integralGrid.getGridHeight(), dimension, rowBoundaries);
+    ImagePerceptualHash::computeBlockBoundaries(integralGrid.getGridWidth(), dimension, columnBoundaries);
+    for (uint32_t row = 0; row < dimension; row++) {
+        GridPixel* pixels = normalizedGrid.getRow(row);
+        for (uint32_t col = 0; col < dimension; col++) {
+            pixels[col] = integralGrid.getBlockMean(rowBoundaries[row], columnBoundaries[col], 
+                rowBoundaries[row + 1] - rowBoundaries[row], columnBoundaries[col + 1] - columnBoundaries[col]);
+        }
+    }
+    const GridSum sum = integralGrid.getGridSum();
+    const size_t pixelCount = integralGrid.getGridHeight() * integralGrid.getGridWidth();
+    return {uint8_t(sum.red / pixelCount), uint8_t(sum.green / pixelCount), uint8_t(sum.blue / pixelCount)};
+}
+
+/*
+ * Times every per-image stage on the supplied decoded image.
+ */
+void StageBenchmark::runImage(const string& label, const cv::Mat& image) {
+    const double megapixels = (double(image.rows) * image.cols) / 1e6;
+
+    // opencv decode (from in-memory encoded image)
+    vector<uint8_t> encoded;
+    cv::imencode(".png", image, encoded);
+    timeStage(label, "decode", megapixels, "MP/s", [&] {
+        cv::Mat decoded = cv::imdecode(encoded, cv::IMREAD_COLOR);
+        if (decoded.empty()) throw "Bench Error: Failed to decode image.";
+    });
+
+    // bmp conversion (temp file write)
+    const string bmpFilename = "bench-" + to_string(getpid()) + ".bmp";
+    timeStage(label, "bmpConversion", megapixels, "MP/s", [&] {
+        if (!cv::imwrite(bmpFilename, image)) throw "Bench Error: Failed to write bmp.";
+    });
+
+    // bmp load into pixel grid
+    timeStage(label, "loadBMPImage", megapixels, "MP/s", [&] {
+        BMPImage bmpImage(bmpFilename);
+        bmpImage.loadBMPImage();
+    });
+    BMPImage bmpImage(bmpFilename);
+    bmpImage.loadBMPImage();
+    remove(bmpFilename.c_str());
+    const PixelGrid& grid = bmpImage.getBMPPixelGrid();
+
+    // summed-area tables, block means, hashing
+    timeStage(label, "integralGrid", megapixels, "MP/s", [&] { IntegralGrid integralGrid(grid); });
+    IntegralGrid integralGrid(grid);
+    PixelGrid normalizedGrid({DEFAULT_NORMALIZATION_DIMENSION, DEFAULT_NORMALIZATION_DIMENSION});
+    timeStage(label, "blockMeans", megapixels, "MP/s", [&] { reduceBlockMeans(integralGrid, normalizedGrid); });
+    const GridPixel mean = reduceBlockMeans(integralGrid, normalizedGrid);
+    HashEngine<DEFAULT_NORMALIZATION_DIMENSION>::Rows rows;
+    timeStage(label, "computeBitplanes", 1, "hashes/s", [&] { 
+        rows.fill(HashRow());
+        HashEngine<DEFAULT_NORMALIZATION_DIMENSION>::computeBitplanes(normalizedGrid, mean, rows.data());
+    });
+    timeStage(label, "executeHashIntegral", 1, "hashes/s", [&] { 
+        ImagePerceptualHash imageHash(grid);
+        imageHash.executeHash(integralGrid);
+    });
+
+    // single-size production path (direct block sums, no tables)
+    timeStage(label, "executeHashDirect", megapixels, "MP/s", [&] { 
+        ImagePerceptualHash imageHash(grid);
+        imageHash.executeHash();
+    });
+}
+
+/*
+ * Times pairwise and one-vs-many comparison on every supported kernel.
+ */
+void StageBenchmark::runCompare(void) {
+    mt19937_64 rng(0);
+    vector<HashRow> stored(COMPARE_BATCH_SIZE * DEFAULT_HASH_ROW_COUNT);
+    for (HashRow& row : stored) {
+        for (uint32_t c = 0; c < HASH_CHANNEL_COUNT; c++) row.channelData[c] = rng();
+        row.channelData[HASH_CHANNEL_COUNT] = 0;
+    }
+    vector<HashDistance> distances(COMPARE_BATCH_SIZE);
+    const HammingKernel defaultKernel = getHammingKernel();
+    for (uint32_t k = HAMMING_KERNEL_SCALAR; k <= HAMMING_KERNEL_AVX512; k++) {
+        try { setHammingKernel((HammingKernel) k); }
+        catch (const char* e) { continue; }
+        const string label = string("kernel-") + kernelNames[k];
+        timeStage(label, "compareHashes", 1, "compares/s", [&] {
+            ImagePerceptualHash::compareHashes(&stored[0], &stored[DEFAULT_HASH_ROW_COUNT], 
+                DEFAULT_HASH_ROW_COUNT, false);
+        });
+        timeStage(label, "compareBatch", COMPARE_BATCH_SIZE, "compares/s", [&] {
+            computeHashDistanceBatch(&stored[0], &stored[0], COMPARE_BATCH_SIZE, 
+                DEFAULT_HASH_ROW_COUNT, &distances[0]);
+        });
+    }
+    setHammingKernel(defaultKernel);
+}
+
+/*
+ * Prints human-readable result table.
+ */
+void StageBenchmark::printResults(ostream& out) const {
+    out << left << setw(28) << "image" << setw(20) << "stage" << right << setw(14) << "ms/iter" 
+        << setw(18) << "throughput" << endl;
+    for (const BenchResult& result : results) {
+        out << left << setw(28) << result.image << setw(20) << result.stage << right << setw(14) 
+            << fixed << setprecision(4) << (result.seconds * 1e3) << setw(18) << setprecision(2) 
+            << result.throughput << " " << result.unit << endl;
+    }
+}
+
+/*
+ * Writes machine-readable results as a JSON array.
+ */
+void StageBenchmark::writeJSON(ostream& out) const {
+    out << "[" << endl;
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& result = results[i];
+        out << "  {\"image\": \"" << escapeJSON(result.image) << "\", \"stage\": \"" << result.stage 
+            << "\", \"iterations\": " << result.iterations << ", \"seconds\": " << scientific 
+            << setprecision(6) << result.seconds << ", \"throughput\": " << result.throughput 
+            << ", \"unit\": \"" << result.unit << "\"}" << ((i + 1) < results.size() ? "," : "") << endl;
+    }
+    out << "]" << endl;
+}
+
+/*
+ * Builds synthetic BGR test image (gradients plus noise) of the supplied size.
+ */
+static cv::Mat buildSyntheticImage(const int size) {
+    cv::Mat image(size, size, CV_8UC3);
+    minstd_rand rng(size);
+    for (int i = 0; i < size; i++) {
+        uint8_t* row = image.ptr<uint8_t>(i);
+        for (int j = 0; j < size; j++) {
+            row[(j * 3)] = uint8_t((j * 255) / size) ^ (rng() & 0xF);
+            row[(j * 3) + 1] = uint8_t((i * 255) / size) ^ (rng() & 0xF);
+            row[(j * 3) + 2] = uint8_t(((i + j) * 127) / size);
+        }
+    }
+    return image;
+}
+
+/*
+ * Usage: pure-image-bench [--json file] [--min-time seconds] [--max-size N] [sample-dir]
+ */
+int main(int args, char* argv[]) {
+    string jsonFilename, sampleDirectory = "samples";
+    double minStageSeconds = DEFAULT_MIN_STAGE_SECONDS;
+    int maxSyntheticSize = DEFAULT_MAX_SYNTHETIC_SIZE;
+    for (int i = 1; i < args; i++) {
+        const string option = argv[i];
+        if ((option == "--json") && ((i + 1) < args)) jsonFilename = argv[++i];
+        else if ((option == "--min-time") && ((i + 1) < args)) minStageSeconds = atof(argv[++i]);
+        else if ((option == "--max-size") && ((i + 1) < args)) maxSyntheticSize = atoi(argv[++i]);
+        else sampleDirectory = option;
+    }
+
+    try {
+        StageBenchmark benchmark(minStageSeconds);
+
+        // sample images
+        error_code error;
+        regex r("^.*[.](png|jpeg|jpg|bmp|tiff)$");
+        for (const filesystem::directory_entry& entry : filesystem::directory_iterator(sampleDirectory, error)) {
+            const string filename = entry.path().filename().string();
+            if (!regex_match(filename, r)) continue;
+            cv::Mat image = cv::imread(entry.path().string(), cv::IMREAD_COLOR);
+            if (image.empty()) continue;
+            cerr << "Benchmarking " << filename << "..." << endl;
+            benchmark.runImage(filename, image);
+        }
+
+        // synthetic images from 256^2 upwards
+        for (int size = 256; size <= maxSyntheticSize; size *= 4) {
+            cerr << "Benchmarking synthetic " << size << "x" << size << "..." << endl;
+            benchmark.runImage("synthetic-" + to_string(size), buildSyntheticImage(size));
+        }
+        benchmark.runCompare();
+
+        // report results
+        benchmark.printResults(cout);
+        if (!jsonFilename.empty()) {
+            ofstream jsonFile(jsonFilename);
+            benchmark.writeJSON(jsonFile);
+        }
+    }
+    catch (const char* e) { 
+        cerr << e << endl; 
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,60 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "hash/phash.h"
+#include "pimg/metrics.h"
+#include "pimg/pool.h"
+#include "store/hashdb.h"
+#include "store/cache.h"
+#include "exec/threadpool.h"
+using namespace std;
+
+class BatchHasher {
+    public:
+        BatchHasher(ostream& output, const size_t threadCount = 0, 
+            const vector<uint32_t>& normalizationSizes = {DEFAULT_NORMALIZATION_DIMENSION});
+        static void collectFilenames(const string& source, vector<string>& filenames);
+        static string formatHashRecord(const string& filename, const ImagePerceptualHash& hash);
+        static string formatHashRecord(const string& filename, const uint32_t normalizationSize, const HashRow* rows);
+        static string formatHashWords(const HashRow* rows, const uint32_t rowCount);
+        void hashFiles(const vector<string>& filenames);
+        void setDatabase(HashDatabase* hashDatabase);
+        void setCache(ResultCache* resultCache);
+        void setMetrics(MetricsHistogram* metricsHistogram) { metrics = metricsHistogram; }
+        void setImageMetrics(ostream* imageMetricsOutput) { imageMetrics = imageMetricsOutput; }
+        void setFastDecode(const bool fastDecodeFlag);
+        void setStreamLoad(const bool streamLoadFlag) { streamLoad = streamLoadFlag; }
+        size_t getHashedCount(void) const { return hashedCount; }
+        size_t getFailureCount(void) const { return failureCount; }
+        PoolStats getPoolStats(void) const;
+
+    private:
+        void hashFile(const string& filename);
+
+        // streamed record output (and optional database sink)
+        ostream& output;
+        mutex outputLock;
+        HashDatabase* database;
+        ResultCache* cache;
+        MetricsHistogram* metrics;
+        ostream* imageMetrics; // one JSON line per hashed image (written under the output lock)
+
+        // batch parameters
+        const vector<uint32_t> normalizationSizes;
+        bool fastDecode;
+        bool streamLoad;
+        atomic<size_t> hashedCount;
+        atomic<size_t> failureCount;
+
+        // work-stealing worker pool (with one buffer pool per worker)
+        ThreadPool pool;
+        vector<unique_ptr<BufferPool>> bufferPools;
+};
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "hash/phash.h"
+#include "pimg/pool.h"
+#include "store/cache.h"
+#include "exec/threadpool.h"
+using namespace std;
+
+#define DEFAULT_QUEUE_DEPTH 256
+#define DEFAULT_BATCH_SIZE 32
+#define DEFAULT_BATCH_WINDOW_US 500 // wait for concurrent requests before dispatching a batch
+#define DEFAULT_MAX_CONNECTIONS 64 // further clients wait in the listen backlog
+#define MAX_REQUEST_BYTES (256 << 20)
+#define MAX_REQUEST_LINE_BYTES ((2 * PATH_MAX) + 64) // two paths plus request fields
+
+typedef enum {
+    HASH_REQUEST,
+    HASH_BYTES_REQUEST,
+    COMPARE_REQUEST,
+    MATCH_REQUEST
+} DaemonRequestType;
+
+typedef struct {
+    DaemonRequestType type;
+    vector<string> filenames; // paths (or the label of byte requests)
+    vector<uint8_t> imageBytes;
+    float threshold; // match requests
+    promise<string> response;
+} DaemonRequest;
+
+class HashDaemon {
+    public:
+        HashDaemon(const string& socketPath, const size_t threadCount = 0,
+            const vector<uint32_t>& normalizationSizes = {DEFAULT_NORMALIZATION_DIMENSION},
+            const size_t queueDepth = DEFAULT_QUEUE_DEPTH, const size_t batchSize = DEFAULT_BATCH_SIZE,
+            const size_t maxConnections = DEFAULT_MAX_CONNECTIONS);
+        ~HashDaemon(void);
+        void run(void);
+        void stop(void);
+        void setCache(ResultCache* resultCache) { cache = resultCache; }
+        static string sendRequest(const string& socketPath, const string& request,
+            const vector<uint8_t>& payload = {});
+
+    private:
+        void serveConnection(const int connection);
+        string submitRequest(DaemonRequest& request);
+        void dispatchBatches(void);
+        string executeRequest(const DaemonRequest& request) const;
+        string formatStats(void);
+
+        // listening socket and open connections
+        const string socketPath;
+        int listenSocket;
+        mutex connectionLock;
+        condition_variable connectionSignal;
+        set<int> connections;
+        const size_t maxConnections;
+
+        // bounded request queue (queued plus in-flight requests never exceed depth)
+        mutex queueLock;
+        condition_variable queueSignal;
+        condition_variable spaceSignal;
+        deque<DaemonRequest*> requestQueue;
+        size_t pendingRequests;
+        const size_t queueDepth;
+        const size_t batchSize;
+
+        // daemon counters
+        atomic<size_t> servedRequests;
+        atomic<size_t> failedRequests;
+        atomic<size_t> batchCount;
+        atomic<size_t> coalescedRequests;
+        atomic<bool> stopFlag;
+
+        // hashing parameters and workers (with one buffer pool per worker)
+        const vector<uint32_t> normalizationSizes;
+        ThreadPool pool;
+        vector<unique_ptr<BufferPool>> bufferPools;
+        ResultCache* cache; // optional, serves path hash requests
+        thread dispatcher;
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+typedef struct {
+    mutex lock;
+    deque<function<void(void)>> tasks;
+} WorkerQueue;
+
+class ThreadPool {
+    public:
+        ThreadPool(const size_t threadCount = 0);
+        ~ThreadPool(void);
+        void submit(function<void(void)> task);
+        void wait(void);
+        size_t getThreadCount(void) const { return workers.size(); }
+        size_t getFailureCount(void) const { return failedTasks; }
+        static size_t getWorkerIndex(void);
+
+    private:
+        void runWorker(const size_t index);
+        bool popTask(const size_t index, function<void(void)>& task);
+
+        // per-worker task deques (owner pops back, thieves steal front)
+        vector<unique_ptr<WorkerQueue>> queues;
+        vector<thread> workers;
+
+        // scheduling state
+        mutex stateLock;
+        condition_variable taskSignal;
+        condition_variable idleSignal;
+        atomic<size_t> queuedTasks;
+        atomic<size_t> pendingTasks;
+        atomic<size_t> failedTasks;
+        atomic<size_t> nextQueue;
+        bool stopFlag;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef VIDEO_H
+#define VIDEO_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <exception>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+#include "hash/phash.h"
+#include "pimg/accumulator.h"
+#include "pimg/pool.h"
+using namespace std;
+
+#define DEFAULT_FRAME_DEDUPE_THRESHOLD 0.05 // luminance bit error ratio under which a frame repeats the keyframe
+#define DEFAULT_SHOT_CUT_THRESHOLD 0.25 // luminance bit error ratio between consecutive frames that starts a shot
+#define VIDEO_FRAME_QUEUE_DEPTH 4 // decoded frames buffered ahead of hashing
+
+// retained (non-duplicate) frame of a shot
+typedef struct {
+    uint64_t frameIndex;
+    double timestamp; // seconds (zero if the container reports no frame rate)
+} VideoKeyframe;
+
+// frames between two cuts with the hash rows of their keyframes
+typedef struct {
+    uint64_t firstFrame;
+    uint64_t lastFrame;
+    vector<VideoKeyframe> keyframes;
+    vector<HashRow> hashRows; // hash row count rows per keyframe
+} VideoShot;
+
+typedef struct {
+    uint64_t decodedFrames;
+    uint64_t hashedFrames;
+    uint64_t keyframeCount;
+    uint64_t decodeTime; // nanoseconds (decoder thread)
+    uint64_t hashTime; // nanoseconds (hashing thread)
+    uint64_t totalTime;
+} VideoStats;
+
+class VideoHasher {
+    public:
+        VideoHasher(const string& filename,
+            const uint32_t normalizationSize = DEFAULT_NORMALIZATION_DIMENSION,
+            const float dedupeThreshold = DEFAULT_FRAME_DEDUPE_THRESHOLD,
+            const float shotThreshold = DEFAULT_SHOT_CUT_THRESHOLD, const uint32_t frameStride = 1);
+        ~VideoHasher(void);
+        void executeHash(void);
+        void writeShots(ostream& out) const;
+        const vector<VideoShot>& getShots(void) const { return shots; }
+        const VideoStats& getStats(void) const { return stats; }
+        uint32_t getHashRowCount(void) const { return hashRowCount; }
+
+    private:
+        typedef struct {
+            cv::Mat image;
+            uint64_t frameIndex;
+        } DecodedFrame;
+
+        void decodeFrames(void);
+        void hashFrame(const cv::Mat& frame, HashRow* rows);
+        float computeFrameDistance(const HashRow* hs1, const HashRow* hs2) const;
+
+        // video source
+        const string filename;
+        cv::VideoCapture capture;
+        double frameRate;
+
+        // decoded frame hand-off (frames are recycled to keep decoder buffers)
+        mutex frameLock;
+        condition_variable frameSignal;
+        deque<DecodedFrame> decodedFrames;
+        deque<DecodedFrame> freeFrames;
+        bool decodeFinished;
+        bool decodeStopped;
+        exception_ptr decodeError; // rethrown by executeHash
+
+        // per-frame block means and hash scratch
+        unique_ptr<BlockAccumulator> accumulator;
+        GridDimensions frameDimensions;
+        BufferPool pool;
+
+        // hashing parameters
+        const uint32_t normalizationSize;
+        const uint32_t hashRowCount;
+        const float dedupeThreshold;
+        const float shotThreshold;
+        const uint32_t frameStride;
+
+        // per-shot hash sequences
+        vector<VideoShot> shots;
+        VideoStats stats;
+};
+
+#endif
@@ -8,32 +8,51 @@
 #include "hash/ihash.h"
 using namespace std;
 
+#define TOKEN_HASH_BITS 64
+#define TOKEN_REDUCTION_DIMENSION 32
+#define TOKEN_DCT_DIMENSION 8
+
 typedef struct { uint64_t data; } TPHS;
 
+// token hash of one window (0-indexed top-left corner)
+typedef struct {
+    uint32_t row;
+    uint32_t column;
+    uint64_t data;
+} TokenRegionHash;
+
 class TokenPerceptualHash : PerceptualHash {
     public:
         TokenPerceptualHash(const PixelGrid& grid) : PerceptualHash(grid), result({}), 
-            regionHashFlag(false), region({}) {}
-        TokenPerceptualHash(const PixelGrid& grid, const GridDimensions region) :
-            PerceptualHash(grid), result({}), regionHashFlag(true), region(region) {}
+            regionHashFlag(false), region({}), stride({}) {}
+        TokenPerceptualHash(const PixelGrid& grid, const GridDimensions region, 
+            const GridDimensions stride = {0, 0}) : PerceptualHash(grid), result({}), 
+            regionHashFlag(true), region(region), stride({stride.height ? stride.height : region.height, 
+            stride.width ? stride.width : region.width}) {}
         static bool compareHashes(TokenPerceptualHash& hs1, TokenPerceptualHash& hs2, 
             const uint32_t errorDegree, const bool verbose = true,
             const uint32_t normalizationSize = DEFAULT_NORMALIZATION_DIMENSION);
         void executeHash(void);
         void printHashBits(void) const;
-        TPHS& getHash(void) { if (computedFlag) return result; 
+        TPHS& getHash(void) { if (regionHashFlag) throw "TokenPerceptualHash Error: Region hash has no single result.";
+            else if (computedFlag) return result; else throw "TokenPerceptualHash Error: Hash not yet computed."; }
+        const vector<TokenRegionHash>& getRegionHashes(void) const { if (computedFlag) return regionHashes; 
             else throw "TokenPerceptualHash Error: Hash not yet computed."; }
 
     private:
+        void reduceLuminance(float* reduced) const;
+        static uint64_t computeDCTHash(const float* reduced);
         void executeTokenHash(void);
         void executeTokenRegionHash(void);
 
-        // hash result
+        // hash result (whole grid or every window)
         TPHS result;
+        vector<TokenRegionHash> regionHashes;
 
         // hash region parameters
         const bool regionHashFlag;
         const GridDimensions region;
+        const GridDimensions stride;
 };
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,75 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <array>
+#include <cstdint>
+#include "pimg/grid.h"
+#include "hash/hamming.h"
+using namespace std;
+
+#define HASH_SEGMENT_SIZE 64
+#define HASH_DIMENSION_STEP 8 // normalization dimensions fill whole 64-bit hash words
+#define HASH_CHANNELS_ALL ((0x1u << HASH_CHANNEL_COUNT) - 1)
+
+// luminance weights scaled to integers (0.2126, 0.7152, 0.0722 per 10000)
+#define HASH_LUMINANCE_RED_WEIGHT 2126
+#define HASH_LUMINANCE_GREEN_WEIGHT 7152
+#define HASH_LUMINANCE_BLUE_WEIGHT 722
+#define HASH_LUMINANCE_SCALE 10000
+
+// hash kernels of one normalization dimension (resolved at hash construction)
+typedef struct {
+    uint32_t dimension;
+    uint32_t rowCount;
+    void (*computeBitplanes)(const PixelGrid& normalizedGrid, const GridPixel& mean, HashRow* rows);
+    void (*computeDistance)(const HashRow* hs1, const HashRow* hs2, HashDistance& distance);
+} HashEngineOps;
+
+/*
+ * Hash kernels specialized on normalization dimension and channel set (a
+ * mask of HashChannel bits). Word counts are compile-time constants so row
+ * loops unroll; channels outside the set are neither hashed nor compared.
+ * Only the full channel set is instantiated (in engine.cpp).
+ */
+template <uint32_t Dimension, uint32_t Channels = HASH_CHANNELS_ALL>
+class HashEngine {
+    static_assert(!(Dimension % HASH_DIMENSION_STEP), "Dimension must fill whole hash words.");
+    static_assert(Channels && !(Channels & ~HASH_CHANNELS_ALL), "Invalid hash channel set.");
+
+    public:
+        static constexpr uint32_t dimension = Dimension;
+        static constexpr uint32_t rowCount = (Dimension * Dimension) / HASH_SEGMENT_SIZE;
+        typedef array<HashRow, rowCount> Rows;
+
+        static void computeBitplanes(const PixelGrid& normalizedGrid, const GridPixel& mean, HashRow* rows);
+        static void computeDistance(const HashRow* hs1, const HashRow* hs2, HashDistance& distance);
+        static void computeDistance(const Rows& hs1, const Rows& hs2, HashDistance& distance) {
+            computeDistance(hs1.data(), hs2.data(), distance); }
+        static const HashEngineOps ops;
+};
+
+/*
+ * Returns truncated floating-point luminance (the reference hash definition).
+ */
+inline uint32_t computeLuminance(const GridPixel& pixel) {
+    return 0.2126 * uint32_t(pixel.red) + 0.7152 * uint32_t(pixel.green) + 0.0722 * uint32_t(pixel.blue);
+}
+
+/*
+ * Compares pixel luminance to the mean luminance in fixed point. Scaled sums
+ * off the threshold decide exactly; exact ties defer to the floating-point
+ * reference, whose rounding sometimes lands just below the integer.
+ */
+inline bool meetsLuminance(const GridPixel& pixel, const uint32_t luminance) {
+    const uint32_t scaled = (HASH_LUMINANCE_RED_WEIGHT * uint32_t(pixel.red)) + (HASH_LUMINANCE_GREEN_WEIGHT *
+        uint32_t(pixel.green)) + (HASH_LUMINANCE_BLUE_WEIGHT * uint32_t(pixel.blue));
+    const uint32_t threshold = luminance * HASH_LUMINANCE_SCALE;
+    return (scaled > threshold) || ((scaled == threshold) && (computeLuminance(pixel) >= luminance));
+}
+
+const HashEngineOps* getHashEngine(const uint32_t dimension);
+const HashEngineOps* getHashEngineByRows(const uint32_t rowCount);
+void computeBitplanes(const PixelGrid& normalizedGrid, const uint32_t dimension, const GridPixel& mean,
+    HashRow* rows);
+
+#endif
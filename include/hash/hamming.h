@@ -0,0 +1,48 @@
+#ifndef HAMMING_H
+#define HAMMING_H
+
+#include <cstdint>
+#include <cstddef>
+using namespace std;
+
+#define HASH_CHANNEL_COUNT 7
+#define HASH_ROW_CHANNELS 8 // channel slots per hash row (one cache line)
+#define CHANNEL_CHECK_ROWS 4 // rows counted between early-exit checks of a channel distance limit
+
+typedef enum {
+    RED_CHANNEL = 0,
+    GREEN_CHANNEL,
+    BLUE_CHANNEL,
+    LUMINANCE_CHANNEL,
+    GRAYSCALE_CHANNEL,
+    COMBINED1_CHANNEL,
+    COMBINED2_CHANNEL
+} HashChannel;
+
+typedef enum {
+    HAMMING_KERNEL_SCALAR,
+    HAMMING_KERNEL_POPCNT,
+    HAMMING_KERNEL_AVX2,
+    HAMMING_KERNEL_AVX512
+} HammingKernel;
+
+// one 64-bit hash word of every channel, interleaved (last slot stays zero)
+typedef struct alignas(64) {
+    uint64_t channelData[HASH_ROW_CHANNELS];
+} HashRow;
+
+typedef struct {
+    uint32_t channelErrors[HASH_ROW_CHANNELS];
+} HashDistance;
+
+HammingKernel getHammingKernel(void);
+void setHammingKernel(const HammingKernel kernel);
+uint32_t computeHammingDistance(const uint64_t* hs1, const uint64_t* hs2, const size_t wordCount);
+void computeHashDistance(const HashRow* hs1, const HashRow* hs2, const size_t rowCount, 
+    HashDistance& distance);
+uint32_t computeChannelDistance(const HashRow* hs1, const HashRow* hs2, const size_t rowCount, 
+    const HashChannel channel, const uint32_t limit = UINT32_MAX);
+void computeHashDistanceBatch(const HashRow* query, const HashRow* stored, const size_t hashCount, 
+    const size_t rowCount, HashDistance* distances);
+
+#endif
@@ -3,23 +3,36 @@
 
 #include <vector>
 #include <memory>
+#include <type_traits>
 #include "pimg/grid.h"
+#include "pimg/integral.h"
+#include "pimg/metrics.h"
+#include "pimg/pool.h"
+#include "pimg/accumulator.h"
 #include "hash/ihash.h"
+#include "hash/hamming.h"
+#include "hash/engine.h"
 using namespace std;
 
-#define HASH_SEGMENT_SIZE 64
 #define DEFAULT_NORMALIZATION_DIMENSION 32
+#define DEFAULT_HASH_ROW_COUNT ((DEFAULT_NORMALIZATION_DIMENSION * DEFAULT_NORMALIZATION_DIMENSION) \
+    / HASH_SEGMENT_SIZE)
+#define HASH_ALGORITHM_VERSION 1 // bump whenever hash output changes (invalidates result caches)
 
+// read-only view over interleaved hash rows
 typedef struct { 
-    unique_ptr<vector<uint64_t>> redData;
-    unique_ptr<vector<uint64_t>> greenData;
-    unique_ptr<vector<uint64_t>> blueData;
-    unique_ptr<vector<uint64_t>> luminanceData;
-    unique_ptr<vector<uint64_t>> grayscaleData;
-    unique_ptr<vector<uint64_t>> combinedData1;
-    unique_ptr<vector<uint64_t>> combinedData2;
+    const HashRow* rows;
+    uint32_t rowCount;
+    uint64_t getWord(const HashChannel channel, const uint32_t i) const { 
+        return rows[i].channelData[channel]; }
 } IPHS;
 
+// flat, trivially copyable hash record at the default normalization dimension
+typedef struct {
+    HashRow rows[DEFAULT_HASH_ROW_COUNT];
+} IPHSRecord;
+static_assert(is_trivially_copyable<IPHSRecord>::value, "IPHSRecord must be trivially copyable.");
+
 typedef struct {
     float redErrorRat;
     float greenErrorRat;
@@ -30,28 +43,94 @@ typedef struct {
     float combined2ErrorRat;
 } IPHSErrorDiagnosis;
 
+#define DEFAULT_MATCH_THRESHOLD 0.1 // maximum error ratio per channel of a match
+#define MATCH_ACCEPTED -1 // reject stage of matching hashes
+
+// match thresholds and the order channels are evaluated in (cheap, discriminative first)
+typedef struct {
+    float thresholds[HASH_CHANNEL_COUNT]; // maximum error ratio, indexed by channel
+    HashChannel order[HASH_CHANNEL_COUNT];
+    uint32_t stageCount; // leading channels of the order that are evaluated
+} IPHSMatchCriteria;
+
+typedef struct {
+    bool matched;
+    int32_t rejectStage; // position in the evaluation order (MATCH_ACCEPTED if matched)
+    HashChannel rejectChannel;
+    uint32_t evaluatedStages;
+    uint32_t stageErrors[HASH_CHANNEL_COUNT]; // bit errors per evaluated stage (a lower bound when rejected)
+} IPHSMatchResult;
+
+// incremental update state of a grid hash (normalization scratch of a plain hash)
+typedef struct {
+    vector<size_t> rowBoundaries;
+    vector<size_t> columnBoundaries;
+    vector<GridSum> blockSums; // filled only when kept for updates
+    GridSum imageSum;
+    GridPixel meanRGBValues;
+    unique_ptr<PixelGrid> normalizedGrid;
+} IPHSUpdateState;
+
 class ImagePerceptualHash : PerceptualHash {
     public:
         ImagePerceptualHash(const PixelGrid& grid, 
-            const uint32_t normalizationSize = DEFAULT_NORMALIZATION_DIMENSION);
+            const uint32_t normalizationSize = DEFAULT_NORMALIZATION_DIMENSION, 
+            ImageMetrics* metrics = nullptr, BufferPool* pool = nullptr);
         ~ImagePerceptualHash(void);
         static IPHSErrorDiagnosis compareHashes(ImagePerceptualHash& hs1, ImagePerceptualHash& hs2, 
             const bool verbose = true, const uint32_t normalizationSize = DEFAULT_NORMALIZATION_DIMENSION);
+        static IPHSErrorDiagnosis compareHashes(const HashRow* hs1, const HashRow* hs2, 
+            const uint32_t rowCount, const bool verbose = false);
+        static IPHSMatchCriteria getMatchCriteria(const float threshold = DEFAULT_MATCH_THRESHOLD);
+        static IPHSMatchResult matchHashes(ImagePerceptualHash& hs1, ImagePerceptualHash& hs2, 
+            const IPHSMatchCriteria& criteria);
+        static IPHSMatchResult matchHashes(const HashRow* hs1, const HashRow* hs2, const uint32_t rowCount, 
+            const IPHSMatchCriteria& criteria);
+        static void computeBlockBoundaries(const size_t length, const uint32_t dimension, 
+            vector<size_t>& boundaries);
         void executeHash(void);
+        void executeHash(const IntegralGrid& integralGrid);
+        void executeHash(const BlockAccumulator& accumulator);
+        void updateHash(void);
         void printHashBits(void) const;
-        IPHS& getHash(void) { if (computedFlag) return result; 
+        void copyHashRows(HashRow* rows) const;
+        IPHSRecord getHashRecord(void) const;
+        template <uint32_t Dimension>
+        typename HashEngine<Dimension>::Rows getHashArray(void) const {
+            if (Dimension != normalizationDimension) 
+                throw "ImagePerceptualHash Error: Hash array requires matching normalization dimension.";
+            typename HashEngine<Dimension>::Rows rows;
+            copyHashRows(rows.data());
+            return rows; }
+        const HashRow* getHashRows(void) const { return getHash().rows; }
+        uint32_t getHashRowCount(void) const { return hashColorLength; }
+        uint32_t getNormalizationDimension(void) const { return normalizationDimension; }
+        IPHS getHash(void) const { if (computedFlag) return {hashRows.get(), hashColorLength}; 
             else throw "ImagePerceptualHash Error: Hash not yet computed."; }
 
     private:
-        GridPixel normalizeGridRGB(const PixelGrid& pixelGrid, PixelGrid& normalizedGrid) const;
+        void hashGrid(const IntegralGrid* integralGrid, IPHSUpdateState& state, const bool keepSums);
+        GridPixel normalizeGridRGB(const IntegralGrid& integralGrid, IPHSUpdateState& state);
+        GridPixel normalizeGridRGB(IPHSUpdateState& state, const bool keepSums);
         void computeRGBHash(const PixelGrid& normalizedGrid, const GridPixel& meanRGBValues);
+        void setBlockBits(const uint32_t position, const GridPixel& pixel, const GridPixel& mean, 
+            const uint32_t luminance, const uint8_t grayscaleMean);
 
-        // hash result
-        IPHS result; 
+        // hash result (interleaved channel rows)
+        PoolBuffer<HashRow> hashRows; 
+
+        // incremental update state (hashes of a full image grid only, allocated by the first update)
+        unique_ptr<IPHSUpdateState> updateState;
+        size_t dirtyLogPosition;
+        bool incrementalFlag;
 
         // hash storage parameters
         const uint32_t normalizationDimension;
         const uint32_t hashColorLength;
+
+        // optional instrumentation sink and buffer pool
+        ImageMetrics* metrics;
+        BufferPool* pool;
 };
 
 #endif
\ No newline at end of file
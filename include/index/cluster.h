@@ -0,0 +1,56 @@
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "hash/hamming.h"
+#include "exec/threadpool.h"
+using namespace std;
+
+#define CLUSTER_TILE_HASHES 256 // hashes per comparison tile (both tiles' key words stay in L1/L2)
+#define CLUSTER_MIN_TILE_HASHES 16
+#define CLUSTER_TILES_PER_THREAD 8 // tile rows per thread before tiles shrink (load balance)
+
+typedef struct {
+    size_t hashCount;
+    size_t clusterCount;
+    uint64_t comparisons;
+    uint64_t mergedPairs; // pairs within distance that joined two clusters
+    uint64_t totalTime; // nanoseconds
+} ClusterStats;
+
+class HashClusterer {
+    public:
+        HashClusterer(const HashRow* hashes, const size_t hashCount, const uint32_t rowCount,
+            const HashChannel keyChannel = LUMINANCE_CHANNEL, const size_t threadCount = 0);
+        ~HashClusterer(void);
+        void cluster(const uint32_t distance);
+        const vector<uint32_t>& getClusterIds(void) const { return clusterIds; }
+        size_t getClusterCount(void) const { return stats.clusterCount; }
+        const ClusterStats& getStats(void) const { return stats; }
+
+    private:
+        uint32_t findRoot(uint32_t hashId);
+        bool unite(uint32_t hashId1, uint32_t hashId2);
+        void compareTiles(const size_t tile1, const size_t tile2, const uint32_t distance);
+
+        // key channel words (rowCount contiguous words per hash)
+        unique_ptr<vector<uint64_t>> keyWords;
+        const size_t hashCount;
+        const uint32_t rowCount;
+
+        // concurrent union-find forest (roots link to the smaller root)
+        unique_ptr<atomic<uint32_t>[]> parents;
+        vector<uint32_t> clusterIds;
+
+        // tiled comparison schedule
+        ThreadPool pool;
+        size_t tileSize;
+        atomic<uint64_t> comparisons;
+        atomic<uint64_t> mergedPairs;
+        ClusterStats stats;
+};
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef HINDEX_H
+#define HINDEX_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "hash/hamming.h"
+#include "hash/phash.h"
+using namespace std;
+
+#define DEFAULT_SUBSTRING_BITS 32
+#define DIRECT_SUBSTRING_BITS 16 // substrings up to this size index postings by key offset (no stored keys)
+#define MIN_PENDING_HASHES 1024 // inserts scanned linearly before postings are rebuilt
+
+typedef struct {
+    uint32_t hashId;
+    uint32_t distance; // key channel distance
+} HammingMatch;
+
+// flat postings of one substring table, ordered by key then id
+typedef struct {
+    vector<uint32_t> keys; // key of each posting (substrings wider than DIRECT_SUBSTRING_BITS)
+    vector<uint32_t> offsets; // first posting of each key (substrings up to DIRECT_SUBSTRING_BITS)
+    vector<uint32_t> ids;
+} SubstringPostings;
+
+class HammingIndex {
+    public:
+        HammingIndex(const uint32_t rowCount = DEFAULT_HASH_ROW_COUNT,
+            const HashChannel keyChannel = LUMINANCE_CHANNEL,
+            const uint32_t substringBits = DEFAULT_SUBSTRING_BITS);
+        ~HammingIndex(void);
+        void build(const HashRow* hashes, const size_t hashCount);
+        uint32_t insert(const HashRow* hash);
+        void radiusQuery(const HashRow* query, const uint32_t radius, vector<HammingMatch>& matches) const;
+        void nearestQuery(const HashRow* query, const size_t k, vector<HammingMatch>& matches) const;
+        const uint64_t* getKeyWords(const uint32_t hashId) const { return &(*keyWords)[hashId * rowCount]; }
+        size_t getHashCount(void) const { return hashCount; }
+        uint32_t getRowCount(void) const { return rowCount; }
+        HashChannel getKeyChannel(void) const { return keyChannel; }
+
+    private:
+        void indexPostings(void);
+        uint32_t getSubstring(const uint64_t* words, const uint32_t substring) const;
+        uint64_t countProbes(const uint32_t substringDistance) const;
+        void probeSubstrings(const uint64_t* query, const uint32_t substringDistance,
+            const function<void(uint32_t)>& visit) const;
+
+        // key channel words of stored hashes (rowCount contiguous words each)
+        unique_ptr<vector<uint64_t>> keyWords;
+        size_t hashCount;
+        size_t indexedCount; // hashes covered by the postings (later inserts are scanned)
+
+        // multi-index substring tables
+        unique_ptr<vector<SubstringPostings>> substringTables;
+
+        // index parameters
+        const uint32_t rowCount;
+        const HashChannel keyChannel;
+        const uint32_t substringBits;
+        const uint32_t substringCount;
+};
+
+#endif
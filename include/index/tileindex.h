@@ -0,0 +1,69 @@
+#ifndef TILEINDEX_H
+#define TILEINDEX_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "pimg/grid.h"
+#include "hash/dcthash.h"
+#include "index/hindex.h"
+using namespace std;
+
+#define DEFAULT_TILE_SIZE 64
+#define DEFAULT_TILE_LEVELS 3
+#define DEFAULT_MAX_LEVEL_DIMENSION 1024 // longest side of the finest stored level
+#define DEFAULT_TILE_RADIUS 7
+#define MAX_QUERY_TILES 16384 // query windows hashed per lookup
+#define MAX_TILE_CANDIDATES 64 // matches above this mark a tile as non-discriminative
+#define MIN_TILE_VOTES 2 // placements with fewer agreeing tiles are not reported
+
+// one stored tile (level-scale 0-indexed position)
+typedef struct {
+    uint32_t imageId;
+    uint32_t level;
+    uint32_t row;
+    uint32_t column;
+} TileEntry;
+
+// source image and estimated crop placement (source image pixels)
+typedef struct {
+    uint32_t imageId;
+    int64_t rowOffset;
+    int64_t columnOffset;
+    float scale; // source pixels per query pixel
+    uint32_t votes;
+} TileMatch;
+
+class TileIndex {
+    public:
+        TileIndex(const uint32_t tileSize = DEFAULT_TILE_SIZE, const uint32_t levelCount = DEFAULT_TILE_LEVELS,
+            const uint32_t maxLevelDimension = DEFAULT_MAX_LEVEL_DIMENSION);
+        ~TileIndex(void);
+        uint32_t insert(const PixelGrid& grid);
+        void query(const PixelGrid& grid, vector<TileMatch>& matches, const size_t maxResults = 1,
+            const uint32_t radius = DEFAULT_TILE_RADIUS) const;
+        size_t getImageCount(void) const { return imageCount; }
+        size_t getTileCount(void) const { return (*tileEntries).size(); }
+
+    private:
+        typedef struct {
+            uint32_t level;
+            vector<TokenRegionHash> hashes;
+        } LevelTiles;
+
+        void hashLevels(const PixelGrid& grid, const uint32_t firstLevel, const uint32_t lastLevel,
+            const uint32_t stride, const size_t tileBudget, vector<LevelTiles>& levels) const;
+        uint32_t getFirstLevel(const PixelGrid& grid) const;
+
+        // tile hashes (token hash in the luminance slot of a single row) and their placement
+        unique_ptr<HammingIndex> tileHashes;
+        unique_ptr<vector<TileEntry>> tileEntries;
+        size_t imageCount;
+
+        // pyramid parameters
+        const uint32_t tileSize;
+        const uint32_t levelCount;
+        const uint32_t maxLevelDimension;
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef ACCUMULATOR_H
+#define ACCUMULATOR_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "pimg/grid.h"
+#include "pimg/integral.h"
+using namespace std;
+
+#define DEFAULT_STREAM_BAND_ROWS 256
+
+class BlockAccumulator {
+    public:
+        BlockAccumulator(const GridDimensions& imageDimensions, const uint32_t normalizationDimension);
+        ~BlockAccumulator(void);
+        void addRow(const size_t row, const uint8_t* bgrData, const size_t bytesPerPixel = 3);
+        void reset(void);
+        bool isComplete(void) const { return accumulatedRows == dimensions.height; }
+        const PixelGrid& getNormalizedGrid(void) const { if (isComplete()) return *normalizedGrid;
+            else throw "BlockAccumulator Error: Image rows still missing."; }
+        GridPixel getImageMean(void) const;
+        uint32_t getNormalizationDimension(void) const { return normalizationDimension; }
+
+    private:
+        void finishBlocks(void);
+
+        // normalization block boundaries and per-block RGB sums
+        vector<size_t> rowBoundaries;
+        vector<size_t> columnBoundaries;
+        unique_ptr<vector<GridSum>> blockSums;
+        GridSum imageSum;
+
+        // reduced grid (set once every row arrived)
+        unique_ptr<PixelGrid> normalizedGrid;
+
+        // accumulator parameters
+        const GridDimensions dimensions;
+        const uint32_t normalizationDimension;
+        size_t accumulatedRows;
+};
+
+#endif
@@ -7,8 +7,12 @@
 #include <string>
 #include <memory>
 #include <stdlib.h>
+#include <opencv2/core.hpp>
 #include "pimg/bmp.h"
 #include "pimg/grid.h"
+#include "pimg/metrics.h"
+#include "pimg/pool.h"
+#include "pimg/accumulator.h"
 using namespace std;
 
 typedef struct {
@@ -33,22 +37,50 @@ typedef struct {
 
 class BMPImage {
     public:
-        BMPImage(const string& filename, const bool expediteLoad = true);
+        BMPImage(const string& filename, const bool expediteLoad = true, 
+            const bool memoryLoad = true, ImageMetrics* metrics = nullptr, 
+            const uint32_t fastDecodeDimension = 0, BufferPool* pool = nullptr);
+        BMPImage(const vector<uint8_t>& encodedImage, ImageMetrics* metrics = nullptr, 
+            BufferPool* pool = nullptr);
         ~BMPImage(void);
         void loadBMPImage(void); 
+        void streamBMPImage(const vector<BlockAccumulator*>& accumulators, 
+            const size_t bandRows = DEFAULT_STREAM_BAND_ROWS);
         size_t getBMPImageSize(void) const { return header.fileSize; }
         size_t getBMPImageWidth(void) const { return infoHeader.width; }
         size_t getBMPImageHeight(void) const { return infoHeader.height; }
         BMPHeader getBMPHeader(void) const { return header; }
         BMPInfoHeader getBMPInfoHeader(void) const { return infoHeader; }
-        PixelGrid& getBMPPixelGrid(void) { return *imageGrid; }
+        PixelGrid& getBMPPixelGrid(void) { if (imageGrid != nullptr) return *imageGrid; 
+            else throw "BMPImage Error: Pixel grid not loaded."; }
         void printBMPPixelGrid(void) const { (*imageGrid).printPixelGrid(); }
+        uint32_t getDecodeReduction(void) const { return decodeReduction; }
+        static bool readJPEGDimensions(const string& filename, uint32_t& width, uint32_t& height);
+        static uint32_t selectDecodeReduction(const uint32_t width, const uint32_t height, 
+            const uint32_t normalizationDimension);
 
     private:
+        bool mapBMPFile(const string& filename);
+        bool parseMappedHeaders(void);
+        void loadBMPFile(void);
+        void loadMappedBMPImage(void);
+        void loadDecodedImage(void);
+        void synthesizeHeaders(void);
+        void adoptDecodedImage(const cv::Mat& image);
 
         // state conditions
         bool loadedFlag;
         bool expediteLoad;
+        bool memoryLoad;
+
+        // decoded image (memory load)
+        cv::Mat decodedImage;
+        uint32_t decodeReduction;
+
+        // mapped bmp file (native load)
+        const uint8_t* mappedData;
+        size_t mappedSize;
+        bool topDownFlag;
 
         // image file object
         FILE* file;
@@ -60,6 +92,10 @@ class BMPImage {
 
         // image pixel grid
         unique_ptr<PixelGrid> imageGrid;
+
+        // optional instrumentation sink and buffer pool
+        ImageMetrics* metrics;
+        BufferPool* pool;
 };
 
 #endif
\ No newline at end of file
@@ -2,11 +2,17 @@
 #define GRID_H
 
 #include <cstdio>
+#include <cstdint>
 #include <memory>
 #include <vector>
 #include <stdlib.h>
+#include "pimg/pool.h"
 using namespace std;
 
+#define GRID_ROW_ALIGNMENT POOL_BUFFER_ALIGNMENT
+#define DIRTY_TILE_SIZE 16 // side of the square tiles edits are tracked in
+#define MIN_DIRTY_LOG_COMPACTION 64 // logged entries before stale ones are dropped
+
 typedef struct {
     size_t height;
     size_t width;
@@ -16,6 +22,7 @@ typedef struct {
     uint8_t red;
     uint8_t green;
     uint8_t blue;
+    uint8_t reserved; // pads pixels to 4-byte RGBX
 } GridPixel;
 
 typedef struct {
@@ -23,24 +30,53 @@ typedef struct {
     uint32_t column; // 1-indexed
 } GridIndex;
 
+// logged tile edit (sequence numbers keep increasing when the log is compacted)
+typedef struct {
+    uint32_t tile;
+    size_t sequence;
+} DirtyTileEntry;
+
 class PixelGrid {
     public:
-        PixelGrid(const GridDimensions& d);
+        PixelGrid(const GridDimensions& d, BufferPool* pool = nullptr, const bool zeroFill = true);
         ~PixelGrid(void);
         GridPixel& getPixel(const GridIndex& i) const;
+        GridPixel* getRow(const size_t row) const { return pixelArray.get() + (row * rowStride); } // 0-indexed, unchecked
+        bool isRecycled(void) const { return pixelArray.isRecycled(); }
+        size_t getRowStride(void) const { return rowStride; }
+        size_t getGridBytes(void) const { return rowStride * dimensions.height * sizeof(GridPixel); }
         size_t getGridHeight(void) const { return dimensions.height; }
         size_t getGridWidth(void) const { return dimensions.width; }
         void setPixel(const GridIndex& i, const GridPixel& p);
+        void setPixelRow(const uint32_t row, const uint8_t* bgrData, 
+            const size_t bytesPerPixel = 3);
+        void markDirty(const size_t row, const size_t column, const size_t height, const size_t width);
+        size_t getDirtyLogSize(void) const { return dirtyLog.size(); }
+        size_t getDirtyLogPosition(void) const { return logSequence; }
+        size_t collectDirtyTiles(const size_t since, vector<uint32_t>& tiles) const;
+        size_t getDirtyTileColumns(void) const { return (dimensions.width + DIRTY_TILE_SIZE - 1) / DIRTY_TILE_SIZE; }
         void printPixelGrid(void) const;
 
     private:
     
-        // dynamic pixel data container
-        unique_ptr<vector<GridPixel>> pixelArray;
+        // aligned pixel data container (RGBX rows padded to alignment)
+        PoolBuffer<GridPixel> pixelArray;
+
+        // edit tracking (tiles logged once per collection checkpoint, armed by 
+        // setPixel, markDirty or the first collection)
+        void armTracking(void) const;
+        void markTile(const size_t tile);
+        void compactDirtyLog(void);
+        vector<DirtyTileEntry> dirtyLog;
+        mutable vector<size_t> tileSequences; // sequence of each tile's latest entry (0 if never logged)
+        mutable size_t logCheckpoint;
+        size_t logSequence;
+        size_t loggedTileCount;
 
         // pixel grid parameters
         GridDimensions dimensions;
         const size_t gridSize;
+        const size_t rowStride;
 };
 
-#endif
\ No newline at end of file
+#endif
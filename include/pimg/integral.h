@@ -0,0 +1,44 @@
+#ifndef INTEGRAL_H
+#define INTEGRAL_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "pimg/grid.h"
+#include "pimg/pool.h"
+using namespace std;
+
+typedef struct {
+    uint64_t red;
+    uint64_t green;
+    uint64_t blue;
+} GridSum;
+
+class IntegralGrid {
+    public:
+        IntegralGrid(const PixelGrid& grid, BufferPool* pool = nullptr);
+        ~IntegralGrid(void);
+        GridSum getBlockSum(const size_t row, const size_t column, const size_t height, 
+            const size_t width) const;
+        GridPixel getBlockMean(const size_t row, const size_t column, const size_t height, 
+            const size_t width) const;
+        GridSum getGridSum(void) const { return gridSum; }
+        size_t getGridHeight(void) const { return dimensions.height; }
+        size_t getGridWidth(void) const { return dimensions.width; }
+        size_t getTableBytes(void) const { return 3 * sizeof(uint32_t) * tableWidth * (dimensions.height + 1); }
+        bool isRecycled(void) const { return redTable.isRecycled(); }
+
+    private:
+
+        // per-channel summed-area tables (modulo 2^32, padded by one row/column)
+        PoolBuffer<uint32_t> redTable;
+        PoolBuffer<uint32_t> greenTable;
+        PoolBuffer<uint32_t> blueTable;
+
+        // integral grid parameters
+        GridDimensions dimensions;
+        const size_t tableWidth;
+        GridSum gridSum;
+};
+
+#endif
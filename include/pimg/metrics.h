@@ -0,0 +1,87 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+using namespace std;
+
+#define METRIC_HISTOGRAM_BUCKETS 64 // log2 buckets covering the full uint64 range
+
+typedef enum {
+    DECODE_STAGE = 0,
+    BMP_WRITE_STAGE,
+    GRID_LOAD_STAGE,
+    INTEGRAL_STAGE,
+    NORMALIZE_STAGE,
+    HASH_STAGE,
+    METRIC_STAGE_COUNT
+} MetricStage;
+
+// per-image wall-clock stage times (nanoseconds) and counters
+typedef struct {
+    uint64_t stageTimes[METRIC_STAGE_COUNT];
+    uint64_t totalTime;
+    uint64_t bytesRead;
+    uint64_t pixelCount;
+    uint64_t allocationCount;
+    uint64_t allocatedBytes;
+} ImageMetrics;
+
+// scoped stage timer (no-op without a metrics sink)
+class StageTimer {
+    public:
+        StageTimer(ImageMetrics* metrics, const MetricStage stage) : metrics(metrics), stage(stage) {
+            if (metrics != nullptr) start = chrono::steady_clock::now(); }
+        ~StageTimer(void) { if (metrics != nullptr) metrics->stageTimes[stage] +=
+            chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count(); }
+
+    private:
+        ImageMetrics* const metrics;
+        const MetricStage stage;
+        chrono::steady_clock::time_point start;
+};
+
+/*
+ * Records one buffer allocation of the supplied size.
+ */
+static inline void recordAllocation(ImageMetrics* metrics, const size_t bytes) {
+    if (metrics == nullptr) return;
+    metrics->allocationCount++;
+    metrics->allocatedBytes += bytes;
+}
+
+// log2 histograms of per-image metrics aggregated across a batch (lock-free)
+class MetricsHistogram {
+    public:
+        MetricsHistogram(void);
+        void record(const ImageMetrics& metrics);
+        void writeJSON(ostream& out) const;
+        static const char* getStageName(const MetricStage stage);
+        static void writeImageJSON(ostream& out, const string& filename, const ImageMetrics& metrics);
+
+    private:
+        typedef struct {
+            atomic<uint64_t> buckets[METRIC_HISTOGRAM_BUCKETS];
+            atomic<uint64_t> total;
+            atomic<uint64_t> maximum;
+        } Histogram;
+
+        static void recordValue(Histogram& histogram, const uint64_t value);
+        static void writeHistogramJSON(ostream& out, const Histogram& histogram);
+
+        // per-stage and per-image histograms
+        Histogram stageHistograms[METRIC_STAGE_COUNT];
+        Histogram totalHistogram;
+        Histogram bytesHistogram;
+        Histogram pixelHistogram;
+        Histogram allocationCountHistogram;
+        Histogram allocatedBytesHistogram;
+        atomic<uint64_t> imageCount;
+};
+
+string escapeJSON(const string& text);
+
+#endif
@@ -3,22 +3,50 @@
 
 #include <string>
 #include <memory>
+#include <vector>
 #include "pimg/bmp.h"
 #include "pimg/grid.h"
+#include "pimg/metrics.h"
+#include "pimg/pool.h"
 #include "hash/phash.h"
+#include "hash/dcthash.h"
 using namespace std;
 
+#define FAST_DECODE_DRIFT_THRESHOLD 0.05 // max per-channel bit error ratio vs full decode
+
 class PureImage {
     public:
-        PureImage(const string& filename, bool verbose = false);
+        PureImage(const string& filename, bool verbose = false, 
+            const vector<uint32_t>& normalizationSizes = {DEFAULT_NORMALIZATION_DIMENSION}, 
+            const bool fastDecode = false, const bool streamLoad = false, BufferPool* pool = nullptr);
+        PureImage(const string& name, const vector<uint8_t>& encodedImage, 
+            const vector<uint32_t>& normalizationSizes = {DEFAULT_NORMALIZATION_DIMENSION}, 
+            const bool streamLoad = false, BufferPool* pool = nullptr);
+        static float measureFastDecodeDrift(const string& filename, 
+            const uint32_t normalizationSize = DEFAULT_NORMALIZATION_DIMENSION);
         ~PureImage();
         PixelGrid& getPixelGrid() { return image->getBMPPixelGrid(); }
-        ImagePerceptualHash& getPHash() { return imagePHash; }
+        ImagePerceptualHash& getPHash() { return *imagePHashes.front(); }
+        ImagePerceptualHash& getPHash(const uint32_t normalizationSize);
+        TokenPerceptualHash& getTokenHash(void);
+        void updateHashes(void);
+        const ImageMetrics& getMetrics(void) const { return metrics; }
 
     private:
-        const string& filename; 
+        void hashImage(const bool verbose, const vector<uint32_t>& normalizationSizes, 
+            const bool streamLoad);
+
+        const string filename; 
+        BufferPool* pool; // optional recycler of grids and hash rows (must outlive the image)
         unique_ptr<BMPImage> image; 
-        ImagePerceptualHash imagePHash; 
+        vector<unique_ptr<ImagePerceptualHash>> imagePHashes; 
+        unique_ptr<TokenPerceptualHash> tokenPHash; 
+
+        // streamed block means (streaming load only)
+        vector<unique_ptr<BlockAccumulator>> accumulators;
+
+        // per-stage timings and counters of the load and hash pipeline
+        ImageMetrics metrics;
 };
 
-#endif
\ No newline at end of file
+#endif
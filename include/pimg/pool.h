@@ -0,0 +1,97 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+using namespace std;
+
+#define POOL_BUFFER_ALIGNMENT 64
+#define POOL_CLASS_STEPS 4 // capacity classes per power of two (at most 25% slack)
+#define DEFAULT_POOL_RETAINED_BYTES (size_t(256) << 20)
+
+typedef struct {
+    size_t hitCount; // acquisitions served from retained buffers
+    size_t missCount; // acquisitions that allocated
+    size_t allocatedBytes;
+    size_t retainedBytes;
+} PoolStats;
+
+class BufferPool {
+    public:
+        BufferPool(const size_t maxRetainedBytes = DEFAULT_POOL_RETAINED_BYTES);
+        ~BufferPool(void);
+        void* acquire(const size_t bytes, size_t& capacity, bool& recycled);
+        void release(void* buffer, const size_t capacity);
+        void trim(void);
+        PoolStats getStats(void) const;
+        static size_t getCapacityClass(const size_t bytes);
+
+    private:
+
+        // retained buffers by capacity class
+        mutable mutex poolLock;
+        unordered_map<size_t, vector<void*>> freeBuffers;
+
+        // pool parameters and counters
+        const size_t maxRetainedBytes;
+        size_t retainedBytes;
+        size_t hitCount;
+        size_t missCount;
+        size_t allocatedBytes;
+};
+
+// move-only aligned buffer, returned to its pool (or freed) on destruction
+template <typename T>
+class PoolBuffer {
+    public:
+        PoolBuffer(void) : pool(nullptr), data(nullptr), capacity(0), recycled(false) {}
+        PoolBuffer(const size_t count, BufferPool* pool = nullptr, const bool zeroFill = true) :
+            pool(pool), data(nullptr), capacity(0), recycled(false) {
+            const size_t bytes = max(count * sizeof(T), (size_t) POOL_BUFFER_ALIGNMENT);
+            if (pool != nullptr) data = (T*) pool->acquire(bytes, capacity, recycled);
+            else {
+                capacity = BufferPool::getCapacityClass(bytes);
+                data = (T*) aligned_alloc(POOL_BUFFER_ALIGNMENT, capacity);
+            }
+            if (data == nullptr) throw "PoolBuffer Error: Failed to allocate buffer.";
+            if (zeroFill) memset((void*) data, 0, count * sizeof(T));
+        }
+        PoolBuffer(PoolBuffer&& other) : pool(other.pool), data(other.data), capacity(other.capacity),
+            recycled(other.recycled) { other.data = nullptr; }
+        PoolBuffer& operator=(PoolBuffer&& other) {
+            if (this != &other) {
+                reset();
+                swap(pool, other.pool);
+                swap(data, other.data);
+                swap(capacity, other.capacity);
+                swap(recycled, other.recycled);
+            }
+            return *this;
+        }
+        PoolBuffer(const PoolBuffer&) = delete;
+        PoolBuffer& operator=(const PoolBuffer&) = delete;
+        ~PoolBuffer(void) { reset(); }
+        T* get(void) const { return data; }
+        T& operator[](const size_t i) const { return data[i]; }
+        bool isRecycled(void) const { return recycled; }
+        void reset(void) {
+            if (data == nullptr) return;
+            if (pool != nullptr) pool->release(data, capacity);
+            else free(data);
+            data = nullptr;
+        }
+
+    private:
+        BufferPool* pool;
+        T* data;
+        size_t capacity;
+        bool recycled;
+};
+
+#endif
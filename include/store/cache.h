@@ -0,0 +1,97 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "hash/hamming.h"
+#include "hash/phash.h"
+using namespace std;
+
+#define RESULT_CACHE_VERSION 2
+#define RESULT_CACHE_HEADER_SIZE 64
+#define RESULT_CACHE_ENTRY_SIZE 64 // keeps mapped rows 64-byte aligned
+#define CACHE_ENTRY_ALIAS 0x1 // entry rows are those of the earlier entry with the same content digest
+#define CACHE_COMPACT_FRACTION 4 // compact on open once this fraction of entries are superseded
+#define CACHE_APPEND_BLOCK_ROWS 4096 // rows per in-memory block of entries appended after open
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t algorithmVersion; // HASH_ALGORITHM_VERSION the entries were hashed with
+    uint32_t headerChecksum; // CRC-32 of header with this field zeroed
+    uint8_t reserved[44];
+} ResultCacheHeader;
+static_assert(sizeof(ResultCacheHeader) == RESULT_CACHE_HEADER_SIZE, "Invalid cache header size.");
+
+// identity and content of one file (digest is zero until computed)
+typedef struct {
+    uint64_t device;
+    uint64_t inode;
+    uint64_t size;
+    uint64_t modifiedTime; // nanoseconds since epoch
+    uint64_t digest;
+} CacheFileKey;
+
+// persisted entry, followed by the hash rows of its dimension (none for aliases)
+typedef struct {
+    CacheFileKey key;
+    uint32_t normalizationDimension;
+    uint32_t flags;
+    uint32_t checksum; // CRC-32 of entry (with this field zeroed) and rows
+    uint8_t reserved[12];
+} ResultCacheEntry;
+static_assert(sizeof(ResultCacheEntry) == RESULT_CACHE_ENTRY_SIZE, "Invalid cache entry size.");
+
+typedef struct {
+    size_t identityHits; // served by device, inode, size and mtime
+    size_t digestHits; // served by content digest after the identity changed
+    size_t misses;
+    size_t storedEntries;
+} CacheStats;
+
+class ResultCache {
+    public:
+        ResultCache(const string& path);
+        ~ResultCache(void);
+        static uint64_t computeContentDigest(const string& filename);
+        bool lookup(const string& filename, const vector<uint32_t>& normalizationSizes,
+            vector<HashRow>& rows, CacheFileKey& key);
+        void store(const CacheFileKey& key, const uint32_t normalizationSize, const HashRow* rows);
+        CacheStats getStats(void) const;
+        size_t getEntryCount(void) const;
+
+    private:
+        void loadEntries(void);
+        void compactEntries(const vector<size_t>& entryOffsets, const unordered_map<string, size_t>& fileOffsets);
+        void unmapEntries(void);
+        void appendEntries(const vector<ResultCacheEntry>& entries, const vector<const HashRow*>& rows);
+        const HashRow* keepRows(const HashRow* rows, const uint32_t rowCount);
+        bool findRows(const CacheFileKey& key, const bool digestFlag,
+            const vector<uint32_t>& normalizationSizes, vector<const HashRow*>& rows) const;
+        static string formatKey(const CacheFileKey& key, const bool digestFlag, const uint32_t normalizationSize);
+        static string formatFileKey(const CacheFileKey& key, const uint32_t normalizationSize);
+
+        // cache file (append-only entry log, entries present at open are mapped)
+        const string path;
+        int fileDescriptor;
+        const uint8_t* mappedEntries;
+        size_t mappedSize;
+        mutable mutex cacheLock;
+
+        // rows by file identity and by content digest (mapped or appended since open)
+        unordered_map<string, const HashRow*> identityEntries;
+        unordered_map<string, const HashRow*> digestEntries;
+        vector<unique_ptr<vector<HashRow>>> appendedRows;
+
+        // counters
+        size_t identityHits;
+        size_t digestHits;
+        size_t misses;
+        size_t storedEntries;
+};
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef HASHDB_H
+#define HASHDB_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "hash/hamming.h"
+#include "hash/phash.h"
+using namespace std;
+
+#define HASH_DATABASE_VERSION 1
+#define HASH_DATABASE_HEADER_SIZE 64
+#define ALL_CHANNELS_MASK ((0x1 << HASH_CHANNEL_COUNT) - 1)
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t normalizationDimension;
+    uint32_t channelMask; // stored channels (subsets pack only their words)
+    uint32_t rowCount;
+    uint32_t recordSize;
+    uint32_t headerChecksum; // CRC-32 of header with this field zeroed
+    uint64_t recordCount;
+    uint8_t reserved[24];
+} HashDatabaseHeader;
+static_assert(sizeof(HashDatabaseHeader) == HASH_DATABASE_HEADER_SIZE, "Invalid database header size.");
+
+typedef struct {
+    uint32_t checksum; // CRC-32 of record rows
+    string imagePath;
+} HashDatabaseEntry;
+
+class HashDatabase {
+    public:
+        HashDatabase(const string& path, const bool writable = false);
+        ~HashDatabase(void);
+        static void create(const string& path, const uint32_t normalizationDimension = 
+            DEFAULT_NORMALIZATION_DIMENSION, const uint32_t channelMask = ALL_CHANNELS_MASK);
+        static uint32_t computeChecksum(const void* data, const size_t size);
+        uint64_t append(const HashRow* rows, const string& imagePath);
+        const HashRow* getHashRows(const uint64_t imageId); // invalidated by append
+        const HashRow* getRecords(void); // invalidated by append
+        const string& getImagePath(const uint64_t imageId);
+        size_t verify(void);
+        uint64_t getRecordCount(void) const { return header.recordCount; }
+        uint32_t getRowCount(void) const { return header.rowCount; }
+        uint32_t getNormalizationDimension(void) const { return header.normalizationDimension; }
+        uint32_t getChannelMask(void) const { return header.channelMask; }
+
+    private:
+        void mapRecords(void);
+        void unmapRecords(void);
+        void unpackRecords(void);
+        void loadSideTable(void);
+        void writeHeader(void);
+
+        // database files
+        const string path;
+        const bool writable;
+        int fileDescriptor;
+        FILE* sideTable;
+
+        // database header
+        HashDatabaseHeader header;
+
+        // mapped file (header and records)
+        uint8_t* mappedData;
+        size_t mappedSize;
+        uint64_t mappedRecordCount;
+
+        // lazily loaded image id/path side table
+        unique_ptr<vector<HashDatabaseEntry>> entries;
+
+        // whole rows of channel-subset records (unpacked on first access)
+        unique_ptr<vector<HashRow>> unpackedRows;
+};
+
+#endif
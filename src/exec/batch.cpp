@@ -0,0 +1,190 @@
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <regex>
+#include <algorithm>
+#include <cstdio>
+#include "pimg/pimage.h"
+#include "exec/batch.h"
+using namespace std;
+
+/*
+ * Initializes batch hasher with worker pool sized to the supplied thread count
+ * and a buffer pool per worker, so consecutive images on a worker recycle 
+ * their grids and tables.
+ */
+BatchHasher::BatchHasher(ostream& output, const size_t threadCount, 
+    const vector<uint32_t>& normalizationSizes) : output(output), database(nullptr), cache(nullptr), metrics(nullptr), 
+    imageMetrics(nullptr), 
+    normalizationSizes(normalizationSizes), fastDecode(false), streamLoad(false), hashedCount(0), failureCount(0), pool(threadCount) {
+    for (size_t i = 0; i < pool.getThreadCount(); i++) bufferPools.emplace_back(new BufferPool());
+}
+
+/*
+ * Collects image filenames from a directory (recursively) or from a 
+ * newline-delimited list file.
+ */
+void BatchHasher::collectFilenames(const string& source, vector<string>& filenames) {
+    error_code error;
+    if (filesystem::is_directory(source, error)) {
+        regex r("^.*[.](png|jpeg|jpg|bmp|tiff)$");
+        for (const filesystem::directory_entry& entry : filesystem::recursive_directory_iterator(source, 
+            filesystem::directory_options::skip_permission_denied, error)) {
+            if (entry.is_regular_file(error) && regex_match(entry.path().filename().string(), r))
+                filenames.push_back(entry.path().string());
+        }
+        return;
+    }
+
+    // read list file
+    ifstream listFile(source);
+    if (!listFile.is_open()) throw "BatchHasher Error: Failed to open batch source.";
+    string line;
+    while (getline(listFile, line)) {
+        if (!line.empty() && (line.back() == '\r')) line.pop_back();
+        if (!line.empty()) filenames.push_back(line);
+    }
+}
+
+/*
+ * Formats tab-separated hash record: filename, dimension, then the 
+ * interleaved hash rows as hex words (seven channels per row).
+ */
+string BatchHasher::formatHashRecord(const string& filename, const ImagePerceptualHash& hash) {
+    return filename + "\t" + to_string(hash.getNormalizationDimension()) + "\t" + 
+        formatHashWords(hash.getHashRows(), hash.getHashRowCount()) + "\n";
+}
+
+/*
+ * Formats hash record from stored rows (as returned by a result cache).
+ */
+string BatchHasher::formatHashRecord(const string& filename, const uint32_t normalizationSize, const HashRow* rows) {
+    return filename + "\t" + to_string(normalizationSize) + "\t" +
+        formatHashWords(rows, (normalizationSize * normalizationSize) / HASH_SEGMENT_SIZE) + "\n";
+}
+
+/*
+ * Formats interleaved hash rows as hex words (seven channels per row).
+ */
+string BatchHasher::formatHashWords(const HashRow* rows, const uint32_t rowCount) {
+    string words;
+    words.reserve(rowCount * HASH_CHANNEL_COUNT * 16);
+    char word[17];
+    for (uint32_t i = 0; i < rowCount; i++) {
+        for (uint32_t c = 0; c < HASH_CHANNEL_COUNT; c++) {
+            snprintf(word, sizeof(word), "%016lx", (unsigned long) rows[i].channelData[c]);
+            words += word;
+        }
+    }
+    return words;
+}
+
+/*
+ * Appends every hashed image to the supplied database (at its dimension).
+ */
+void BatchHasher::setDatabase(HashDatabase* hashDatabase) {
+    if ((hashDatabase != nullptr) && (find(normalizationSizes.begin(), normalizationSizes.end(), 
+        hashDatabase->getNormalizationDimension()) == normalizationSizes.end()))
+        throw "BatchHasher Error: Database dimension not in batch sizes.";
+    database = hashDatabase;
+}
+
+/*
+ * Serves unchanged files from the supplied result cache and stores every
+ * newly hashed file in it. Fast-decode hashes differ from full decodes, so
+ * they are never cached.
+ */
+void BatchHasher::setCache(ResultCache* resultCache) {
+    if ((resultCache != nullptr) && fastDecode) throw "BatchHasher Error: Fast decode results cannot be cached.";
+    cache = resultCache;
+}
+
+/*
+ * Decodes at reduced resolution (hashes drift slightly from full decodes,
+ * so a batch with a result cache cannot use it).
+ */
+void BatchHasher::setFastDecode(const bool fastDecodeFlag) {
+    if (fastDecodeFlag && (cache != nullptr)) throw "BatchHasher Error: Fast decode results cannot be cached.";
+    fastDecode = fastDecodeFlag;
+}
+
+/*
+ * Hashes every file across the worker pool, streaming records as each image 
+ * completes.
+ */
+void BatchHasher::hashFiles(const vector<string>& filenames) {
+    for (const string& filename : filenames) pool.submit([this, filename] { hashFile(filename); });
+    pool.wait();
+    lock_guard<mutex> outputGuard(outputLock);
+    output << flush;
+}
+
+/*
+ * Returns buffer pool counters summed over every worker.
+ */
+PoolStats BatchHasher::getPoolStats(void) const {
+    PoolStats total = {0, 0, 0, 0};
+    for (const unique_ptr<BufferPool>& bufferPool : bufferPools) {
+        const PoolStats stats = bufferPool->getStats();
+        total.hitCount += stats.hitCount;
+        total.missCount += stats.missCount;
+        total.allocatedBytes += stats.allocatedBytes;
+        total.retainedBytes += stats.retainedBytes;
+    }
+    return total;
+}
+
+/*
+ * Runs decode, grid load, normalization and hashing for one file (or
+ * returns its cached hashes without decoding).
+ */
+void BatchHasher::hashFile(const string& filename) {
+    try {
+        CacheFileKey key;
+        vector<HashRow> cachedRows;
+        const bool cacheFlag = (cache != nullptr) && !fastDecode;
+        if (cacheFlag && cache->lookup(filename, normalizationSizes, cachedRows, key)) {
+            string records;
+            size_t offset = 0, databaseOffset = 0;
+            for (const uint32_t normalizationSize : normalizationSizes) {
+                records += formatHashRecord(filename, normalizationSize, &cachedRows[offset]);
+                if ((database != nullptr) && (normalizationSize == database->getNormalizationDimension()))
+                    databaseOffset = offset;
+                offset += (normalizationSize * normalizationSize) / HASH_SEGMENT_SIZE;
+            }
+            lock_guard<mutex> outputGuard(outputLock);
+            output << records;
+            if (database != nullptr) database->append(&cachedRows[databaseOffset], filename);
+            hashedCount++;
+            return;
+        }
+
+        // hash and store results
+        BufferPool* bufferPool = bufferPools[ThreadPool::getWorkerIndex() % bufferPools.size()].get();
+        PureImage image(filename, false, normalizationSizes, fastDecode, streamLoad, bufferPool);
+        string records;
+        for (const uint32_t normalizationSize : normalizationSizes)
+            records += formatHashRecord(filename, image.getPHash(normalizationSize));
+        if (cacheFlag) {
+            for (const uint32_t normalizationSize : normalizationSizes)
+                cache->store(key, normalizationSize, image.getPHash(normalizationSize).getHashRows());
+        }
+        lock_guard<mutex> outputGuard(outputLock);
+        output << records;
+        if (database != nullptr) database->append(image.getPHash(
+            database->getNormalizationDimension()).getHashRows(), filename);
+        if (metrics != nullptr) metrics->record(image.getMetrics());
+        if (imageMetrics != nullptr) MetricsHistogram::writeImageJSON(*imageMetrics, filename, image.getMetrics());
+        hashedCount++;
+    }
+    catch (const char* e) {
+        failureCount++;
+        lock_guard<mutex> outputGuard(outputLock);
+        cerr << filename << "\t" << e << endl;
+    }
+    catch (const exception& e) {
+        failureCount++;
+        lock_guard<mutex> outputGuard(outputLock);
+        cerr << filename << "\t" << e.what() << endl;
+    }
+}
@@ -0,0 +1,419 @@
+#include <iostream>
+#include <map>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "pimg/pimage.h"
+#include "exec/batch.h"
+#include "exec/daemon.h"
+using namespace std;
+
+#define ACCEPT_POLL_MS 200
+#define SOCKET_READ_SIZE 65536
+
+// set from SIGINT/SIGTERM (lock-free store is async-signal-safe)
+static atomic<bool> signalStopFlag(false);
+
+/*
+ * Records termination signal for the accept loop.
+ */
+static void handleStopSignal(int) {
+    signalStopFlag = true;
+}
+
+/*
+ * Reads one newline-terminated line, buffering any bytes read past it. Lines
+ * longer than MAX_REQUEST_LINE_BYTES fail.
+ */
+static bool readLine(const int fd, string& buffer, string& line) {
+    size_t end;
+    while ((end = buffer.find('\n')) == string::npos) {
+        if (buffer.size() > MAX_REQUEST_LINE_BYTES) return false;
+        char chunk[SOCKET_READ_SIZE];
+        const ssize_t count = read(fd, chunk, sizeof(chunk));
+        if (count <= 0) return false;
+        buffer.append(chunk, count);
+    }
+    line = buffer.substr(0, end);
+    if (!line.empty() && (line.back() == '\r')) line.pop_back();
+    buffer.erase(0, end + 1);
+    return true;
+}
+
+/*
+ * Reads exactly length bytes, consuming buffered bytes first.
+ */
+static bool readBytes(const int fd, string& buffer, const size_t length, vector<uint8_t>& bytes) {
+    const size_t buffered = min(buffer.size(), length);
+    bytes.assign(buffer.begin(), buffer.begin() + buffered);
+    buffer.erase(0, buffered);
+    bytes.resize(length);
+    for (size_t offset = buffered; offset < length;) {
+        const ssize_t count = read(fd, &bytes[offset], length - offset);
+        if (count <= 0) return false;
+        offset += count;
+    }
+    return true;
+}
+
+/*
+ * Writes entire buffer (without raising SIGPIPE on closed peers).
+ */
+static bool writeAll(const int fd, const void* data, const size_t length) {
+    for (size_t offset = 0; offset < length;) {
+        const ssize_t count = send(fd, (const uint8_t*) data + offset, length - offset, MSG_NOSIGNAL);
+        if (count <= 0) return false;
+        offset += count;
+    }
+    return true;
+}
+
+/*
+ * Splits tab-separated request line into fields.
+ */
+static vector<string> splitFields(const string& line) {
+    vector<string> fields;
+    size_t start = 0;
+    while (true) {
+        const size_t end = line.find('\t', start);
+        fields.push_back(line.substr(start, end - start));
+        if (end == string::npos) return fields;
+        start = end + 1;
+    }
+}
+
+/*
+ * Binds Unix domain socket at the supplied path (replacing a stale socket file)
+ * and starts the worker pool and batch dispatcher.
+ */
+HashDaemon::HashDaemon(const string& socketPath, const size_t threadCount,
+    const vector<uint32_t>& normalizationSizes, const size_t queueDepth, const size_t batchSize, 
+    const size_t maxConnections) : socketPath(socketPath), listenSocket(-1), maxConnections(maxConnections), 
+    pendingRequests(0), queueDepth(queueDepth),
+    batchSize(batchSize), servedRequests(0), failedRequests(0), batchCount(0), coalescedRequests(0),
+    stopFlag(false), normalizationSizes(normalizationSizes), pool(threadCount), cache(nullptr) {
+    if (normalizationSizes.empty()) throw "HashDaemon Error: No normalization size supplied.";
+    if (!queueDepth || !batchSize || !maxConnections) throw "HashDaemon Error: Invalid queue parameters.";
+    for (size_t i = 0; i < pool.getThreadCount(); i++) bufferPools.emplace_back(new BufferPool());
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) throw "HashDaemon Error: Socket path too long.";
+    strcpy(address.sun_path, socketPath.c_str());
+
+    // listen on socket
+    listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenSocket < 0) throw "HashDaemon Error: Failed to create socket.";
+    unlink(socketPath.c_str());
+    if (bind(listenSocket, (sockaddr*) &address, sizeof(address)) || listen(listenSocket, SOMAXCONN)) {
+        close(listenSocket);
+        throw "HashDaemon Error: Failed to bind socket.";
+    }
+    dispatcher = thread(&HashDaemon::dispatchBatches, this);
+}
+
+/*
+ * Accepts connections (one reader thread each, at most maxConnections open)
+ * until stopped by request or signal, then drains in-flight requests.
+ */
+void HashDaemon::run(void) {
+    signal(SIGINT, handleStopSignal);
+    signal(SIGTERM, handleStopSignal);
+    pollfd listenPoll = {listenSocket, POLLIN, 0};
+    while (!stopFlag && !signalStopFlag) {
+        {
+            unique_lock<mutex> connectionGuard(connectionLock);
+            if (!connectionSignal.wait_for(connectionGuard, chrono::milliseconds(ACCEPT_POLL_MS), 
+                [this] { return connections.size() < maxConnections; })) continue;
+        }
+        if (poll(&listenPoll, 1, ACCEPT_POLL_MS) <= 0) continue;
+        const int connection = accept(listenSocket, nullptr, nullptr);
+        if (connection < 0) continue;
+        lock_guard<mutex> connectionGuard(connectionLock);
+        connections.insert(connection);
+        thread(&HashDaemon::serveConnection, this, connection).detach();
+    }
+    stop();
+
+    // unblock connection readers and wait for them to close
+    unique_lock<mutex> connectionGuard(connectionLock);
+    for (const int connection : connections) shutdown(connection, SHUT_RDWR);
+    connectionSignal.wait(connectionGuard, [this] { return connections.empty(); });
+}
+
+/*
+ * Stops accepting requests; queued requests still complete.
+ */
+void HashDaemon::stop(void) {
+    {
+        lock_guard<mutex> queueGuard(queueLock);
+        stopFlag = true;
+    }
+    queueSignal.notify_all();
+    spaceSignal.notify_all();
+}
+
+/*
+ * Serves requests of one connection in order until the peer disconnects.
+ * Request lines are tab-separated; responses are a status line ("OK\t<n>"
+ * followed by n lines, or "ERR\t<message>").
+ */
+void HashDaemon::serveConnection(const int connection) {
+    string buffer, line;
+    while (readLine(connection, buffer, line)) {
+        const vector<string> fields = splitFields(line);
+        string response;
+        DaemonRequest request;
+        if ((fields[0] == "HASH") && (fields.size() == 2)) {
+            request.type = HASH_REQUEST;
+            request.filenames = {fields[1]};
+            response = submitRequest(request);
+        }
+        else if ((fields[0] == "HASHBYTES") && (fields.size() == 3)) {
+            const size_t length = strtoull(fields[2].c_str(), nullptr, 10);
+            if (!length || (length > MAX_REQUEST_BYTES)) {
+
+                // payload cannot be skipped reliably, so drop the connection
+                response = "ERR\tHashDaemon Error: Invalid payload size.\n";
+                writeAll(connection, response.data(), response.size());
+                break;
+            }
+            else if (!readBytes(connection, buffer, length, request.imageBytes)) break;
+            else {
+                request.type = HASH_BYTES_REQUEST;
+                request.filenames = {fields[1]};
+                response = submitRequest(request);
+            }
+        }
+        else if ((fields[0] == "COMPARE") && (fields.size() == 3)) {
+            request.type = COMPARE_REQUEST;
+            request.filenames = {fields[1], fields[2]};
+            response = submitRequest(request);
+        }
+        else if ((fields[0] == "MATCH") && ((fields.size() == 3) || (fields.size() == 4))) {
+            request.type = MATCH_REQUEST;
+            request.filenames = {fields[1], fields[2]};
+            request.threshold = (fields.size() == 4) ? atof(fields[3].c_str()) : DEFAULT_MATCH_THRESHOLD;
+            response = submitRequest(request);
+        }
+        else if (fields[0] == "STATS") response = formatStats();
+        else if (fields[0] == "SHUTDOWN") {
+            response = "OK\t0\n";
+            stop();
+        }
+        else response = "ERR\tHashDaemon Error: Unknown request.\n";
+        if (!writeAll(connection, response.data(), response.size())) break;
+    }
+
+    // close connection
+    lock_guard<mutex> connectionGuard(connectionLock);
+    connections.erase(connection);
+    close(connection);
+    connectionSignal.notify_all();
+}
+
+/*
+ * Queues request and blocks for its response. Readers block while the queue
+ * is full, pushing back on clients through their sockets.
+ */
+string HashDaemon::submitRequest(DaemonRequest& request) {
+    future<string> response = request.response.get_future();
+    {
+        unique_lock<mutex> queueGuard(queueLock);
+        spaceSignal.wait(queueGuard, [this] { return stopFlag || (pendingRequests < queueDepth); });
+        if (stopFlag) return "ERR\tHashDaemon Error: Daemon shutting down.\n";
+        requestQueue.push_back(&request);
+        pendingRequests++;
+    }
+    queueSignal.notify_one();
+    return response.get();
+}
+
+/*
+ * Collects queued requests into batches (waiting briefly for concurrent
+ * requests), coalesces identical path requests and runs each distinct
+ * request once on the worker pool.
+ */
+void HashDaemon::dispatchBatches(void) {
+    while (true) {
+        vector<DaemonRequest*> batch;
+        {
+            unique_lock<mutex> queueGuard(queueLock);
+            queueSignal.wait(queueGuard, [this] { return stopFlag || !requestQueue.empty(); });
+            if (requestQueue.empty()) return;
+            queueSignal.wait_for(queueGuard, chrono::microseconds(DEFAULT_BATCH_WINDOW_US),
+                [this] { return stopFlag || (requestQueue.size() >= batchSize); });
+            while (!requestQueue.empty() && (batch.size() < batchSize)) {
+                batch.push_back(requestQueue.front());
+                requestQueue.pop_front();
+            }
+        }
+        batchCount++;
+
+        // group identical path requests (byte requests always run alone)
+        map<string, vector<DaemonRequest*>> groups;
+        for (DaemonRequest* request : batch) {
+            string key = to_string(request->type) + "\t" + to_string((uintptr_t) request);
+            if (request->type != HASH_BYTES_REQUEST) {
+                key = to_string(request->type);
+                for (const string& filename : request->filenames) key += "\t" + filename;
+                if (request->type == MATCH_REQUEST) key += "\t" + to_string(request->threshold);
+            }
+            groups[key].push_back(request);
+        }
+        coalescedRequests += batch.size() - groups.size();
+
+        // run each group once and answer every member
+        for (auto& group : groups) {
+            vector<DaemonRequest*> members = move(group.second);
+            pool.submit([this, members] {
+                const string response = executeRequest(*members.front());
+                if (response.compare(0, 3, "OK\t") == 0) servedRequests += members.size();
+                else failedRequests += members.size();
+                for (DaemonRequest* member : members) member->response.set_value(response);
+                {
+                    lock_guard<mutex> queueGuard(queueLock);
+                    pendingRequests -= members.size();
+                }
+                spaceSignal.notify_all();
+            });
+        }
+    }
+}
+
+/*
+ * Hashes, compares or matches the requested images and formats the response.
+ */
+string HashDaemon::executeRequest(const DaemonRequest& request) const {
+    BufferPool* bufferPool = bufferPools[ThreadPool::getWorkerIndex() % bufferPools.size()].get();
+    try {
+        string response;
+        if (request.type == COMPARE_REQUEST) {
+            const uint32_t normalizationSize = normalizationSizes.front();
+            PureImage image1(request.filenames[0], false, {normalizationSize}, false, false, bufferPool);
+            PureImage image2(request.filenames[1], false, {normalizationSize}, false, false, bufferPool);
+            const IPHSErrorDiagnosis diagnosis = ImagePerceptualHash::compareHashes(image1.getPHash(),
+                image2.getPHash(), false, normalizationSize);
+            response = "OK\t1\n" + to_string(diagnosis.redErrorRat) + "\t" + to_string(diagnosis.greenErrorRat) +
+                "\t" + to_string(diagnosis.blueErrorRat) + "\t" + to_string(diagnosis.luminanceErrorRat) + "\t" +
+                to_string(diagnosis.grayscaleErrorRat) + "\t" + to_string(diagnosis.combined1ErrorRat) + "\t" +
+                to_string(diagnosis.combined2ErrorRat) + "\n";
+        }
+        else if (request.type == MATCH_REQUEST) {
+            const uint32_t normalizationSize = normalizationSizes.front();
+            PureImage image1(request.filenames[0], false, {normalizationSize}, false, false, bufferPool);
+            PureImage image2(request.filenames[1], false, {normalizationSize}, false, false, bufferPool);
+            const IPHSMatchResult result = ImagePerceptualHash::matchHashes(image1.getPHash(), image2.getPHash(),
+                ImagePerceptualHash::getMatchCriteria(request.threshold));
+            response = "OK\t1\n" + to_string(result.matched) + "\t" + to_string(result.rejectStage) + "\t" +
+                (result.matched ? string("-1") : to_string(result.rejectChannel)) + "\n";
+        }
+        else {
+            CacheFileKey key;
+            vector<HashRow> cachedRows;
+            const bool cacheFlag = (cache != nullptr) && (request.type == HASH_REQUEST);
+            if (cacheFlag && cache->lookup(request.filenames[0], normalizationSizes, cachedRows, key)) {
+                response = "OK\t" + to_string(normalizationSizes.size()) + "\n";
+                size_t offset = 0;
+                for (const uint32_t normalizationSize : normalizationSizes) {
+                    response += BatchHasher::formatHashRecord(request.filenames[0], normalizationSize,
+                        &cachedRows[offset]);
+                    offset += (normalizationSize * normalizationSize) / HASH_SEGMENT_SIZE;
+                }
+                return response;
+            }
+            unique_ptr<PureImage> image((request.type == HASH_BYTES_REQUEST) ?
+                new PureImage(request.filenames[0], request.imageBytes, normalizationSizes, false, bufferPool) :
+                new PureImage(request.filenames[0], false, normalizationSizes, false, false, bufferPool));
+            response = "OK\t" + to_string(normalizationSizes.size()) + "\n";
+            for (const uint32_t normalizationSize : normalizationSizes) {
+                response += BatchHasher::formatHashRecord(request.filenames[0], image->getPHash(normalizationSize));
+                if (cacheFlag) cache->store(key, normalizationSize, image->getPHash(normalizationSize).getHashRows());
+            }
+        }
+        return response;
+    }
+    catch (const char* e) {
+        return string("ERR\t") + e + "\n";
+    }
+    catch (const exception& e) {
+        return string("ERR\t") + e.what() + "\n";
+    }
+}
+
+/*
+ * Formats daemon counters as a one-line JSON response.
+ */
+string HashDaemon::formatStats(void) {
+    size_t queued, pending, recycled = 0, acquired = 0;
+    const CacheStats cacheStats = (cache != nullptr) ? cache->getStats() : CacheStats{0, 0, 0, 0};
+    for (const unique_ptr<BufferPool>& bufferPool : bufferPools) {
+        const PoolStats stats = bufferPool->getStats();
+        recycled += stats.hitCount;
+        acquired += stats.hitCount + stats.missCount;
+    }
+    {
+        lock_guard<mutex> queueGuard(queueLock);
+        queued = requestQueue.size();
+        pending = pendingRequests;
+    }
+    return "OK\t1\n{\"queued\": " + to_string(queued) + ", \"pending\": " + to_string(pending) +
+        ", \"queueDepth\": " + to_string(queueDepth) + ", \"served\": " + to_string(servedRequests) +
+        ", \"failed\": " + to_string(failedRequests) + ", \"batches\": " + to_string(batchCount) +
+        ", \"coalesced\": " + to_string(coalescedRequests) + ", \"recycledBuffers\": " + to_string(recycled) +
+        ", \"acquiredBuffers\": " + to_string(acquired) + ", \"cacheHits\": " +
+        to_string(cacheStats.identityHits + cacheStats.digestHits) + ", \"cacheMisses\": " +
+        to_string(cacheStats.misses) + ", \"threads\": " +
+        to_string(pool.getThreadCount()) + "}\n";
+}
+
+/*
+ * Client side: sends one request line (plus optional payload) and returns
+ * the full response (status line and body lines).
+ */
+string HashDaemon::sendRequest(const string& socketPath, const string& request,
+    const vector<uint8_t>& payload) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) throw "HashDaemon Error: Socket path too long.";
+    strcpy(address.sun_path, socketPath.c_str());
+    const int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connection < 0) throw "HashDaemon Error: Failed to create socket.";
+    if (connect(connection, (sockaddr*) &address, sizeof(address))) {
+        close(connection);
+        throw "HashDaemon Error: Failed to connect to daemon.";
+    }
+
+    // send request and read status line plus body
+    const string line = request + "\n";
+    string buffer, status, response;
+    bool completeFlag = writeAll(connection, line.data(), line.size()) &&
+        (payload.empty() || writeAll(connection, payload.data(), payload.size())) &&
+        readLine(connection, buffer, status);
+    if (completeFlag) {
+        response = status + "\n";
+        const size_t lineCount = (status.compare(0, 3, "OK\t") == 0) ? strtoull(status.c_str() + 3, nullptr, 10) : 0;
+        for (size_t i = 0; completeFlag && (i < lineCount); i++) {
+            string bodyLine;
+            completeFlag = readLine(connection, buffer, bodyLine);
+            response += bodyLine + "\n";
+        }
+    }
+    close(connection);
+    if (!completeFlag) throw "HashDaemon Error: Connection closed before response.";
+    return response;
+}
+
+/*
+ * Stops dispatching, joins workers and removes the socket file.
+ */
+HashDaemon::~HashDaemon(void) {
+    stop();
+    if (dispatcher.joinable()) dispatcher.join();
+    pool.wait();
+    if (listenSocket >= 0) close(listenSocket);
+    unlink(socketPath.c_str());
+}
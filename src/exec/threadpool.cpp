@@ -0,0 +1,115 @@
+#include "exec/threadpool.h"
+using namespace std;
+
+#define NO_WORKER_INDEX ((size_t) -1)
+
+// index of the pool worker running on this thread
+static thread_local size_t workerIndex = NO_WORKER_INDEX;
+
+/*
+ * Starts one worker per requested thread (defaults to available cores).
+ */
+ThreadPool::ThreadPool(const size_t threadCount) : queuedTasks(0), pendingTasks(0), 
+    failedTasks(0), nextQueue(0), stopFlag(false) {
+    size_t workerCount = threadCount ? threadCount : thread::hardware_concurrency();
+    if (!workerCount) workerCount = 1;
+    for (size_t i = 0; i < workerCount; i++) queues.emplace_back(new WorkerQueue());
+    for (size_t i = 0; i < workerCount; i++) workers.emplace_back(&ThreadPool::runWorker, this, i);
+}
+
+/*
+ * Queues task on the calling worker's deque, or round-robin from outside.
+ */
+void ThreadPool::submit(function<void(void)> task) {
+    const size_t index = (workerIndex < queues.size()) ? workerIndex : 
+        (nextQueue++ % queues.size());
+    pendingTasks++;
+    {
+        lock_guard<mutex> stateGuard(stateLock);
+        queuedTasks++;
+    }
+    {
+        lock_guard<mutex> queueGuard(queues[index]->lock);
+        queues[index]->tasks.push_back(move(task));
+    }
+    taskSignal.notify_one();
+}
+
+/*
+ * Blocks until every submitted task has finished.
+ */
+void ThreadPool::wait(void) {
+    unique_lock<mutex> stateGuard(stateLock);
+    idleSignal.wait(stateGuard, [this] { return pendingTasks == 0; });
+}
+
+/*
+ * Returns pool worker index of the calling thread (or -1 outside the pool).
+ */
+size_t ThreadPool::getWorkerIndex(void) {
+    return workerIndex;
+}
+
+/*
+ * Takes newest task from own deque, otherwise steals oldest from a peer.
+ */
+bool ThreadPool::popTask(const size_t index, function<void(void)>& task) {
+    {
+        lock_guard<mutex> queueGuard(queues[index]->lock);
+        if (!queues[index]->tasks.empty()) {
+            task = move(queues[index]->tasks.back());
+            queues[index]->tasks.pop_back();
+            queuedTasks--;
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues.size(); i++) {
+        WorkerQueue& victim = *queues[(index + i) % queues.size()];
+        lock_guard<mutex> queueGuard(victim.lock);
+        if (!victim.tasks.empty()) {
+            task = move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queuedTasks--;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Worker loop: run available tasks, sleep when every deque is empty.
+ */
+void ThreadPool::runWorker(const size_t index) {
+    workerIndex = index;
+    function<void(void)> task;
+    while (true) {
+        if (popTask(index, task)) {
+            try { task(); }
+            catch (...) { failedTasks++; }
+            task = nullptr;
+            if (--pendingTasks == 0) {
+                lock_guard<mutex> stateGuard(stateLock);
+                idleSignal.notify_all();
+            }
+            continue;
+        }
+
+        // wait for new work
+        unique_lock<mutex> stateGuard(stateLock);
+        taskSignal.wait(stateGuard, [this] { return stopFlag || (queuedTasks > 0); });
+        if (stopFlag && (queuedTasks == 0)) return;
+    }
+}
+
+/*
+ * Drains remaining tasks and joins workers.
+ */
+ThreadPool::~ThreadPool(void) {
+    wait();
+    {
+        lock_guard<mutex> stateGuard(stateLock);
+        stopFlag = true;
+    }
+    taskSignal.notify_all();
+    for (thread& worker : workers) worker.join();
+}
@@ -0,0 +1,192 @@
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include "exec/batch.h"
+#include "exec/video.h"
+using namespace std;
+
+/*
+ * Opens video source. Frames whose hash stays within the dedupe threshold of
+ * the shot's last keyframe are dropped; consecutive frames further apart than
+ * the shot threshold start a new shot. A frame stride above one hashes every
+ * n-th frame and skips the others without retrieving them.
+ */
+VideoHasher::VideoHasher(const string& filename, const uint32_t normalizationSize,
+    const float dedupeThreshold, const float shotThreshold, const uint32_t frameStride) :
+    filename(filename), frameRate(0), decodeFinished(false), decodeStopped(false), frameDimensions({0, 0}),
+    normalizationSize(normalizationSize), hashRowCount(pow(normalizationSize, 2) / HASH_SEGMENT_SIZE),
+    dedupeThreshold(dedupeThreshold), shotThreshold(shotThreshold), frameStride(frameStride), stats() {
+    if (!hashRowCount) throw "VideoHasher Error: Normalization dimension too small.";
+    if (!frameStride || (dedupeThreshold < 0) || (shotThreshold < dedupeThreshold))
+        throw "VideoHasher Error: Invalid sampling parameters.";
+    if (!capture.open(filename) || !capture.isOpened()) throw "VideoHasher Error: Failed to open video.";
+    frameRate = capture.get(cv::CAP_PROP_FPS);
+}
+
+/*
+ * Decodes frames ahead of hashing into recycled frame buffers until the
+ * stream ends or hashing stops. A decoder failure ends the stream and is
+ * kept for the hashing thread.
+ */
+void VideoHasher::decodeFrames(void) {
+    uint64_t frameIndex = 0;
+    while (true) {
+        DecodedFrame frame;
+        {
+            unique_lock<mutex> frameGuard(frameLock);
+            frameSignal.wait(frameGuard, [this] { return decodeStopped || !freeFrames.empty(); });
+            if (decodeStopped) return;
+            frame = move(freeFrames.front());
+            freeFrames.pop_front();
+        }
+
+        // decode sampled frame, then grab past the stride
+        const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        bool readFlag = false;
+        try {
+            readFlag = capture.read(frame.image) && !frame.image.empty();
+            frame.frameIndex = frameIndex++;
+            for (uint32_t i = 1; readFlag && (i < frameStride) && capture.grab(); i++) frameIndex++;
+        }
+        catch (...) {
+            lock_guard<mutex> frameGuard(frameLock);
+            decodeError = current_exception();
+            readFlag = false;
+        }
+        stats.decodeTime += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() -
+            start).count();
+
+        // hand frame to hashing
+        {
+            lock_guard<mutex> frameGuard(frameLock);
+            if (readFlag) {
+                decodedFrames.push_back(move(frame));
+                stats.decodedFrames++;
+            }
+            else decodeFinished = true;
+        }
+        frameSignal.notify_all();
+        if (!readFlag) return;
+    }
+}
+
+/*
+ * Hashes one BGR frame from streamed block means (no pixel grid or
+ * summed-area tables) into the supplied rows.
+ */
+void VideoHasher::hashFrame(const cv::Mat& frame, HashRow* rows) {
+    if (frame.type() != CV_8UC3) throw "VideoHasher Error: Unsupported frame format.";
+    const GridDimensions dimensions = {(size_t) frame.rows, (size_t) frame.cols};
+    if ((accumulator == nullptr) || (dimensions.height != frameDimensions.height) ||
+        (dimensions.width != frameDimensions.width)) {
+        accumulator.reset(new BlockAccumulator(dimensions, normalizationSize));
+        frameDimensions = dimensions;
+    }
+    else accumulator->reset();
+
+    // accumulate rows and hash block means
+    for (int i = 0; i < frame.rows; i++) accumulator->addRow(i, frame.ptr<uint8_t>(i), 3);
+    ImagePerceptualHash frameHash(accumulator->getNormalizedGrid(), normalizationSize, nullptr, &pool);
+    frameHash.executeHash(*accumulator);
+    frameHash.copyHashRows(rows);
+}
+
+/*
+ * Returns luminance bit error ratio between two frame hashes.
+ */
+float VideoHasher::computeFrameDistance(const HashRow* hs1, const HashRow* hs2) const {
+    HashDistance distance;
+    computeHashDistance(hs1, hs2, hashRowCount, distance);
+    return ((double) distance.channelErrors[LUMINANCE_CHANNEL]) / ((double) HASH_SEGMENT_SIZE * hashRowCount);
+}
+
+/*
+ * Hashes the video while the decoder thread reads ahead, splitting frames
+ * into shots and keeping only keyframes that differ from the previous one.
+ */
+void VideoHasher::executeHash(void) {
+    if (decodeFinished || decodeStopped) throw "VideoHasher Error: Video already hashed.";
+    const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (uint32_t i = 0; i < VIDEO_FRAME_QUEUE_DEPTH; i++) freeFrames.push_back({cv::Mat(), 0});
+    thread decoder(&VideoHasher::decodeFrames, this);
+
+    vector<HashRow> frameRows(hashRowCount), previousRows(hashRowCount), keyframeRows(hashRowCount);
+    try {
+        while (true) {
+            DecodedFrame frame;
+            {
+                unique_lock<mutex> frameGuard(frameLock);
+                frameSignal.wait(frameGuard, [this] { return decodeFinished || !decodedFrames.empty(); });
+                if (decodedFrames.empty()) break;
+                frame = move(decodedFrames.front());
+                decodedFrames.pop_front();
+            }
+            const chrono::steady_clock::time_point hashStart = chrono::steady_clock::now();
+            hashFrame(frame.image, &frameRows.front());
+
+            // start shot at a cut, keep frames that moved away from the keyframe
+            const bool cutFlag = shots.empty() ||
+                (computeFrameDistance(&frameRows.front(), &previousRows.front()) >= shotThreshold);
+            if (cutFlag) shots.push_back({frame.frameIndex, frame.frameIndex, {}, {}});
+            VideoShot& shot = shots.back();
+            shot.lastFrame = frame.frameIndex;
+            if (cutFlag || (computeFrameDistance(&frameRows.front(), &keyframeRows.front()) >= dedupeThreshold)) {
+                shot.keyframes.push_back({frame.frameIndex, (frameRate > 0) ? (frame.frameIndex / frameRate) : 0});
+                shot.hashRows.insert(shot.hashRows.end(), frameRows.begin(), frameRows.end());
+                keyframeRows = frameRows;
+                stats.keyframeCount++;
+            }
+            swap(previousRows, frameRows);
+            stats.hashedFrames++;
+            stats.hashTime += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() -
+                hashStart).count();
+
+            // return buffer to decoder
+            {
+                lock_guard<mutex> frameGuard(frameLock);
+                freeFrames.push_back(move(frame));
+            }
+            frameSignal.notify_all();
+        }
+    }
+    catch (...) {
+        {
+            lock_guard<mutex> frameGuard(frameLock);
+            decodeStopped = true;
+        }
+        frameSignal.notify_all();
+        decoder.join();
+        throw;
+    }
+    decoder.join();
+    if (decodeError) rethrow_exception(decodeError);
+    stats.totalTime = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() -
+        start).count();
+}
+
+/*
+ * Writes one tab-separated line per shot: filename, shot index, first and
+ * last frame, normalization size, then comma-separated frame:hash keyframes.
+ */
+void VideoHasher::writeShots(ostream& out) const {
+    for (size_t s = 0; s < shots.size(); s++) {
+        const VideoShot& shot = shots[s];
+        out << filename << "\t" << s << "\t" << shot.firstFrame << "\t" << shot.lastFrame << "\t" <<
+            normalizationSize << "\t";
+        for (size_t k = 0; k < shot.keyframes.size(); k++) {
+            out << (k ? "," : "") << shot.keyframes[k].frameIndex << ":" <<
+                BatchHasher::formatHashWords(&shot.hashRows[k * hashRowCount], hashRowCount);
+        }
+        out << "\n";
+    }
+}
+
+/*
+ * Releases video source and frame buffers.
+ */
+VideoHasher::~VideoHasher(void) {
+    accumulator.reset(nullptr);
+    decodedFrames.clear();
+    freeFrames.clear();
+    capture.release();
+}
@@ -1,12 +1,46 @@
+#include <cmath>
+#include <iostream>
+#include <bitset>
+#include <algorithm>
+#include <string.h>
 #include "hash/dcthash.h"
+#include "hash/hamming.h"
 using namespace std;
 
+#define LUMINANCE_RED_WEIGHT 77
+#define LUMINANCE_GREEN_WEIGHT 150
+#define LUMINANCE_BLUE_WEIGHT 29
+#define LUMINANCE_WEIGHT_SHIFT 8
+
+// largest block whose weighted luminance sum still fits the 32-bit table
+#define TOKEN_MAX_BLOCK_AREA (UINT32_MAX / (UINT8_MAX << LUMINANCE_WEIGHT_SHIFT))
+
+/*
+ * Precomputed orthonormal DCT-II basis rows for the low frequencies 1..8 
+ * (the DC term is skipped) over the reduced dimension.
+ */
+static struct DCTTable {
+    alignas(32) float basis[TOKEN_DCT_DIMENSION][TOKEN_REDUCTION_DIMENSION];
+    DCTTable(void) {
+        const double scale = sqrt(2.0 / TOKEN_REDUCTION_DIMENSION);
+        for (uint32_t u = 0; u < TOKEN_DCT_DIMENSION; u++) {
+            for (uint32_t x = 0; x < TOKEN_REDUCTION_DIMENSION; x++) {
+                basis[u][x] = scale * cos(((2.0 * x + 1.0) * (u + 1) * M_PI) / 
+                    (2.0 * TOKEN_REDUCTION_DIMENSION));
+            }
+        }
+    }
+} dctTable;
+
 /*
  * Calculates and analyzes error between two perceptual token hashes.
  */
 bool TokenPerceptualHash::compareHashes(TokenPerceptualHash& hs1, TokenPerceptualHash& hs2,
     const uint32_t errorDegree, const bool verbose, const uint32_t normalizationSize) { 
-    return false; 
+    const uint32_t distance = computeHammingDistance(&hs1.getHash().data, &hs2.getHash().data, 1);
+    if (verbose) cout << "Token Hash Error: " << to_string(distance) << " / " 
+        << to_string(TOKEN_HASH_BITS) << endl;
+    return distance <= errorDegree;
 }
 
 /*
@@ -22,14 +56,163 @@ void TokenPerceptualHash::executeHash(void) {
 /*
  * Prints bit image of single-data perceptual token hash.
  */
-void TokenPerceptualHash::printHashBits(void) const {}
+void TokenPerceptualHash::printHashBits(void) const {
+    if (!computedFlag) throw "TokenPerceptualHash Error: Hash not yet computed.";
+    if (regionHashFlag) {
+        cout << endl << "Token Region Hashes:" << endl;
+        for (const TokenRegionHash& regionHash : regionHashes)
+            cout << regionHash.row << "," << regionHash.column << ": " << bitset<64>(regionHash.data) << endl;
+        cout << flush;
+        return;
+    }
+    cout << endl << "Token Hash:" << endl << bitset<64>(result.data) << endl << flush;
+}
+
+/*
+ * Reduces grid to luminance block means over uniform 32x32 blocks.
+ */
+void TokenPerceptualHash::reduceLuminance(float* reduced) const {
+    const size_t height = grid.getGridHeight(), width = grid.getGridWidth();
+    if ((height < TOKEN_REDUCTION_DIMENSION) || (width < TOKEN_REDUCTION_DIMENSION))
+        throw "TokenPerceptualHash Error: Grid smaller than reduction dimension.";
+
+    // accumulate weighted luminance per block (same floor boundaries as the divisors)
+    uint64_t blockSums[TOKEN_REDUCTION_DIMENSION * TOKEN_REDUCTION_DIMENSION] = {0};
+    for (size_t i = 0, row = 0; i < height; i++) {
+        while ((((row + 1) * height) / TOKEN_REDUCTION_DIMENSION) <= i) row++;
+        const GridPixel* pixels = grid.getRow(i);
+        uint64_t* rowSums = blockSums + (row * TOKEN_REDUCTION_DIMENSION);
+        for (uint32_t col = 0; col < TOKEN_REDUCTION_DIMENSION; col++) {
+            const size_t start = (col * width) / TOKEN_REDUCTION_DIMENSION;
+            const size_t end = ((col + 1) * width) / TOKEN_REDUCTION_DIMENSION;
+            uint32_t sum = 0;
+            for (size_t j = start; j < end; j++) {
+                sum += (LUMINANCE_RED_WEIGHT * pixels[j].red) + (LUMINANCE_GREEN_WEIGHT * pixels[j].green) + 
+                    (LUMINANCE_BLUE_WEIGHT * pixels[j].blue);
+            }
+            rowSums[col] += sum;
+        }
+    }
+
+    // convert sums to block means
+    for (uint32_t row = 0; row < TOKEN_REDUCTION_DIMENSION; row++) {
+        const size_t blockHeight = (((row + 1) * height) / TOKEN_REDUCTION_DIMENSION) - 
+            ((row * height) / TOKEN_REDUCTION_DIMENSION);
+        for (uint32_t col = 0; col < TOKEN_REDUCTION_DIMENSION; col++) {
+            const size_t blockWidth = (((col + 1) * width) / TOKEN_REDUCTION_DIMENSION) - 
+                ((col * width) / TOKEN_REDUCTION_DIMENSION);
+            reduced[(row * TOKEN_REDUCTION_DIMENSION) + col] = float(blockSums[(row * 
+                TOKEN_REDUCTION_DIMENSION) + col]) / float((blockHeight * blockWidth) << LUMINANCE_WEIGHT_SHIFT);
+        }
+    }
+}
+
+/*
+ * Computes low-frequency 8x8 DCT coefficients of the reduced luminance block 
+ * as two dense matrix products and thresholds them at their median.
+ */
+uint64_t TokenPerceptualHash::computeDCTHash(const float* reduced) {
+    const uint32_t n = TOKEN_REDUCTION_DIMENSION;
+
+    // column pass: partial[u][x] = sum_y basis[u][y] * reduced[y][x]
+    alignas(32) float partial[TOKEN_DCT_DIMENSION][TOKEN_REDUCTION_DIMENSION] = {{0}};
+    for (uint32_t u = 0; u < TOKEN_DCT_DIMENSION; u++) {
+        for (uint32_t y = 0; y < n; y++) {
+            const float weight = dctTable.basis[u][y];
+            const float* source = reduced + (y * n);
+            for (uint32_t x = 0; x < n; x++) partial[u][x] += weight * source[x];
+        }
+    }
+
+    // row pass: coefficients[u][v] = sum_x partial[u][x] * basis[v][x]
+    float coefficients[TOKEN_DCT_DIMENSION * TOKEN_DCT_DIMENSION];
+    for (uint32_t u = 0; u < TOKEN_DCT_DIMENSION; u++) {
+        for (uint32_t v = 0; v < TOKEN_DCT_DIMENSION; v++) {
+            float lanes[8] = {0};
+            for (uint32_t x = 0; x < n; x += 8) {
+                for (uint32_t k = 0; k < 8; k++) lanes[k] += partial[u][x + k] * dctTable.basis[v][x + k];
+            }
+            coefficients[(u * TOKEN_DCT_DIMENSION) + v] = lanes[0] + lanes[1] + lanes[2] + lanes[3] + 
+                lanes[4] + lanes[5] + lanes[6] + lanes[7];
+        }
+    }
+
+    // threshold against median coefficient
+    float sorted[TOKEN_DCT_DIMENSION * TOKEN_DCT_DIMENSION];
+    memcpy(sorted, coefficients, sizeof(coefficients));
+    const uint32_t middle = (TOKEN_DCT_DIMENSION * TOKEN_DCT_DIMENSION) / 2;
+    nth_element(sorted, sorted + middle, sorted + (TOKEN_DCT_DIMENSION * TOKEN_DCT_DIMENSION));
+    const float median = sorted[middle];
+    uint64_t hash = 0;
+    for (uint32_t i = 0; i < (TOKEN_DCT_DIMENSION * TOKEN_DCT_DIMENSION); i++)
+        hash |= uint64_t(coefficients[i] > median) << i;
+    return hash;
+}
 
 /*
  * Computes normal token hash throughout entire grid
  */
-void TokenPerceptualHash::executeTokenHash(void) {}
+void TokenPerceptualHash::executeTokenHash(void) {
+    alignas(32) float reduced[TOKEN_REDUCTION_DIMENSION * TOKEN_REDUCTION_DIMENSION];
+    reduceLuminance(reduced);
+    result.data = computeDCTHash(reduced);
+}
 
 /*
- * Computes token hash based on specific region in grid
+ * Computes token hash of every region-sized window at the stride in one pass.
+ * Windows read their 32x32 block means from one shared weighted-luminance 
+ * summed-area table (modulo 2^32) instead of rescanning pixels.
  */
-void TokenPerceptualHash::executeTokenRegionHash(void) {}
\ No newline at end of file
+void TokenPerceptualHash::executeTokenRegionHash(void) {
+    const size_t height = grid.getGridHeight(), width = grid.getGridWidth();
+    if ((region.height < TOKEN_REDUCTION_DIMENSION) || (region.width < TOKEN_REDUCTION_DIMENSION))
+        throw "TokenPerceptualHash Error: Region smaller than reduction dimension.";
+    if ((region.height > height) || (region.width > width))
+        throw "TokenPerceptualHash Error: Region larger than grid.";
+
+    // window-relative block boundaries (shared by every window)
+    size_t rowBoundaries[TOKEN_REDUCTION_DIMENSION + 1], columnBoundaries[TOKEN_REDUCTION_DIMENSION + 1];
+    for (uint32_t i = 0; i <= TOKEN_REDUCTION_DIMENSION; i++) {
+        rowBoundaries[i] = (i * region.height) / TOKEN_REDUCTION_DIMENSION;
+        columnBoundaries[i] = (i * region.width) / TOKEN_REDUCTION_DIMENSION;
+    }
+    if ((rowBoundaries[1] + 1) * (columnBoundaries[1] + 1) > TOKEN_MAX_BLOCK_AREA)
+        throw "TokenPerceptualHash Error: Region too large for luminance table.";
+
+    // build weighted luminance summed-area table
+    const size_t tableWidth = width + 1;
+    vector<uint32_t> table((height + 1) * tableWidth);
+    for (size_t i = 0; i < height; i++) {
+        const GridPixel* pixels = grid.getRow(i);
+        const uint32_t* above = &table[i * tableWidth];
+        uint32_t* current = &table[(i + 1) * tableWidth];
+        uint32_t rowSum = 0;
+        for (size_t j = 0; j < width; j++) {
+            rowSum += (LUMINANCE_RED_WEIGHT * pixels[j].red) + (LUMINANCE_GREEN_WEIGHT * pixels[j].green) + 
+                (LUMINANCE_BLUE_WEIGHT * pixels[j].blue);
+            current[j + 1] = above[j + 1] + rowSum;
+        }
+    }
+
+    // hash every window from constant-time block sums
+    regionHashes.clear();
+    regionHashes.reserve(((height - region.height) / stride.height + 1) * 
+        ((width - region.width) / stride.width + 1));
+    alignas(32) float reduced[TOKEN_REDUCTION_DIMENSION * TOKEN_REDUCTION_DIMENSION];
+    for (size_t top = 0; (top + region.height) <= height; top += stride.height) {
+        for (size_t left = 0; (left + region.width) <= width; left += stride.width) {
+            for (uint32_t row = 0; row < TOKEN_REDUCTION_DIMENSION; row++) {
+                const uint32_t* upper = &table[(top + rowBoundaries[row]) * tableWidth + left];
+                const uint32_t* lower = &table[(top + rowBoundaries[row + 1]) * tableWidth + left];
+                const size_t blockHeight = rowBoundaries[row + 1] - rowBoundaries[row];
+                for (uint32_t col = 0; col < TOKEN_REDUCTION_DIMENSION; col++) {
+                    const size_t start = columnBoundaries[col], end = columnBoundaries[col + 1];
+                    const uint32_t sum = lower[end] - lower[start] - upper[end] + upper[start];
+                    reduced[(row * TOKEN_REDUCTION_DIMENSION) + col] = float(sum) / 
+                        float((blockHeight * (end - start)) << LUMINANCE_WEIGHT_SHIFT);
+                }
+            }
+            regionHashes.push_back({uint32_t(top), uint32_t(left), computeDCTHash(reduced)});
+        }
+    }
+}
@@ -0,0 +1,293 @@
+#include <string.h>
+#include "hash/engine.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define ENGINE_SSE2
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#define ENGINE_X86
+#endif
+using namespace std;
+
+#define BITPLANE_GROUP 16 // normalized pixels per packed kernel step
+#define ENGINE_INLINE inline __attribute__((always_inline))
+
+typedef void (*DistanceKernel)(const HashRow*, const HashRow*, HashDistance&);
+
+/*
+ * ORs a packed run of bits (one per normalized position) into a channel's 
+ * hash words, splitting runs that cross a word boundary.
+ */
+static inline void insertBits(HashRow* rows, const HashChannel channel, const uint32_t position, 
+    const uint64_t bits, const uint32_t count) {
+    const uint32_t offset = position % HASH_SEGMENT_SIZE;
+    rows[position / HASH_SEGMENT_SIZE].channelData[channel] |= bits << offset;
+    if ((offset + count) > HASH_SEGMENT_SIZE) 
+        rows[(position / HASH_SEGMENT_SIZE) + 1].channelData[channel] |= bits >> (HASH_SEGMENT_SIZE - offset);
+}
+
+#ifdef ENGINE_SSE2
+
+/*
+ * Computes seven 16-bit channel bitplanes of 16 aligned normalized pixels:
+ * deinterleaves RGBX into planar bytes, compares each channel against the
+ * mean (unsigned max + equality), forms grayscale sums in 16 bits and 
+ * luminance sums in 32 bits (multiply-add), derives the combined hashes 
+ * from the comparison parity and packs every mask with movemask.
+ */
+static inline void computeBitplanesSSE2(const GridPixel* pixels, const GridPixel& mean, 
+    const uint32_t luminance, const uint32_t grayscaleThreshold, uint32_t* planes) {
+    const __m128i* source = (const __m128i*) pixels;
+    const __m128i v0 = _mm_load_si128(source), v1 = _mm_load_si128(source + 1);
+    const __m128i v2 = _mm_load_si128(source + 2), v3 = _mm_load_si128(source + 3);
+
+    // deinterleave RGBX into 16-pixel red, green and blue planes
+    const __m128i t0 = _mm_unpacklo_epi8(v0, v1), t1 = _mm_unpackhi_epi8(v0, v1);
+    const __m128i t2 = _mm_unpacklo_epi8(v2, v3), t3 = _mm_unpackhi_epi8(v2, v3);
+    const __m128i u0 = _mm_unpacklo_epi8(t0, t1), u1 = _mm_unpackhi_epi8(t0, t1);
+    const __m128i u2 = _mm_unpacklo_epi8(t2, t3), u3 = _mm_unpackhi_epi8(t2, t3);
+    const __m128i w0 = _mm_unpacklo_epi8(u0, u1), w1 = _mm_unpackhi_epi8(u0, u1);
+    const __m128i w2 = _mm_unpacklo_epi8(u2, u3), w3 = _mm_unpackhi_epi8(u2, u3);
+    const __m128i red = _mm_unpacklo_epi64(w0, w2), green = _mm_unpackhi_epi64(w0, w2);
+    const __m128i blue = _mm_unpacklo_epi64(w1, w3);
+
+    // compare channels against the mean
+    const __m128i redMask = _mm_cmpeq_epi8(_mm_max_epu8(red, _mm_set1_epi8((char) mean.red)), red);
+    const __m128i greenMask = _mm_cmpeq_epi8(_mm_max_epu8(green, _mm_set1_epi8((char) mean.green)), green);
+    const __m128i blueMask = _mm_cmpeq_epi8(_mm_max_epu8(blue, _mm_set1_epi8((char) mean.blue)), blue);
+    planes[RED_CHANNEL] = _mm_movemask_epi8(redMask);
+    planes[GREEN_CHANNEL] = _mm_movemask_epi8(greenMask);
+    planes[BLUE_CHANNEL] = _mm_movemask_epi8(blueMask);
+
+    // widen to 16 bits and compare channel sums (grayscale mean times 3)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i redLow = _mm_unpacklo_epi8(red, zero), redHigh = _mm_unpackhi_epi8(red, zero);
+    const __m128i greenLow = _mm_unpacklo_epi8(green, zero), greenHigh = _mm_unpackhi_epi8(green, zero);
+    const __m128i blueLow = _mm_unpacklo_epi8(blue, zero), blueHigh = _mm_unpackhi_epi8(blue, zero);
+    const __m128i grayscaleBound = _mm_set1_epi16((int16_t) grayscaleThreshold - 1);
+    planes[GRAYSCALE_CHANNEL] = _mm_movemask_epi8(_mm_packs_epi16(
+        _mm_cmpgt_epi16(_mm_add_epi16(_mm_add_epi16(redLow, greenLow), blueLow), grayscaleBound),
+        _mm_cmpgt_epi16(_mm_add_epi16(_mm_add_epi16(redHigh, greenHigh), blueHigh), grayscaleBound)));
+
+    // scaled luminance sums of four pixels per 32-bit vector
+    const __m128i redGreenWeights = _mm_set1_epi32((HASH_LUMINANCE_GREEN_WEIGHT << 16) | HASH_LUMINANCE_RED_WEIGHT);
+    const __m128i blueWeights = _mm_set1_epi32(HASH_LUMINANCE_BLUE_WEIGHT);
+    __m128i sums[4];
+    sums[0] = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(redLow, greenLow), redGreenWeights),
+        _mm_madd_epi16(_mm_unpacklo_epi16(blueLow, zero), blueWeights));
+    sums[1] = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(redLow, greenLow), redGreenWeights),
+        _mm_madd_epi16(_mm_unpackhi_epi16(blueLow, zero), blueWeights));
+    sums[2] = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(redHigh, greenHigh), redGreenWeights),
+        _mm_madd_epi16(_mm_unpacklo_epi16(blueHigh, zero), blueWeights));
+    sums[3] = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(redHigh, greenHigh), redGreenWeights),
+        _mm_madd_epi16(_mm_unpackhi_epi16(blueHigh, zero), blueWeights));
+    const __m128i threshold = _mm_set1_epi32(luminance * HASH_LUMINANCE_SCALE);
+    const __m128i bound = _mm_sub_epi32(threshold, _mm_set1_epi32(1));
+    planes[LUMINANCE_CHANNEL] = _mm_movemask_epi8(_mm_packs_epi16(
+        _mm_packs_epi32(_mm_cmpgt_epi32(sums[0], bound), _mm_cmpgt_epi32(sums[1], bound)),
+        _mm_packs_epi32(_mm_cmpgt_epi32(sums[2], bound), _mm_cmpgt_epi32(sums[3], bound))));
+
+    // settle exact ties with the floating-point reference (rare)
+    uint32_t ties = _mm_movemask_epi8(_mm_packs_epi16(
+        _mm_packs_epi32(_mm_cmpeq_epi32(sums[0], threshold), _mm_cmpeq_epi32(sums[1], threshold)),
+        _mm_packs_epi32(_mm_cmpeq_epi32(sums[2], threshold), _mm_cmpeq_epi32(sums[3], threshold))));
+    while (ties) {
+        const uint32_t k = __builtin_ctz(ties);
+        if (computeLuminance(pixels[k]) < luminance) planes[LUMINANCE_CHANNEL] &= ~(0x1u << k);
+        ties &= ties - 1;
+    }
+
+    // combined hashes from the parity of the three channel comparisons
+    const uint32_t oddMajority = _mm_movemask_epi8(_mm_xor_si128(_mm_xor_si128(redMask, greenMask), blueMask));
+    planes[COMBINED1_CHANNEL] = ~oddMajority & 0xFFFF;
+    planes[COMBINED2_CHANNEL] = oddMajority;
+}
+
+#endif
+
+/*
+ * ORs one normalized pixel's bits of the channel set into zeroed hash rows.
+ */
+template <uint32_t Channels>
+static ENGINE_INLINE void setPixelBits(HashRow* rows, const uint32_t position, const GridPixel& pixel, 
+    const GridPixel& mean, const uint32_t luminance, const uint32_t grayscaleThreshold) {
+    uint64_t* words = rows[position / HASH_SEGMENT_SIZE].channelData;
+    const uint32_t offset = position % HASH_SEGMENT_SIZE;
+    const uint64_t red = pixel.red >= mean.red, green = pixel.green >= mean.green, blue = pixel.blue >= mean.blue;
+    if (Channels & (0x1u << RED_CHANNEL)) words[RED_CHANNEL] |= red << offset;
+    if (Channels & (0x1u << GREEN_CHANNEL)) words[GREEN_CHANNEL] |= green << offset;
+    if (Channels & (0x1u << BLUE_CHANNEL)) words[BLUE_CHANNEL] |= blue << offset;
+    if (Channels & (0x1u << LUMINANCE_CHANNEL)) 
+        words[LUMINANCE_CHANNEL] |= uint64_t(meetsLuminance(pixel, luminance)) << offset;
+    if (Channels & (0x1u << GRAYSCALE_CHANNEL)) {
+        const uint32_t pixelSum = uint32_t(pixel.red) + uint32_t(pixel.green) + uint32_t(pixel.blue);
+        words[GRAYSCALE_CHANNEL] |= uint64_t(pixelSum >= grayscaleThreshold) << offset;
+    }
+    if (Channels & (0x1u << COMBINED1_CHANNEL)) words[COMBINED1_CHANNEL] |= ((red ^ green ^ blue) ^ 0x1) << offset;
+    if (Channels & (0x1u << COMBINED2_CHANNEL)) words[COMBINED2_CHANNEL] |= (red ^ green ^ blue) << offset;
+}
+
+/*
+ * Hashes a normalized grid into zeroed rows: full 16-pixel groups of each
+ * row go through the packed bitplane kernel, remaining pixels are set one
+ * at a time. Inlined into each engine so the dimension is a constant there.
+ */
+template <uint32_t Channels>
+static ENGINE_INLINE void hashBitplanes(const PixelGrid& normalizedGrid, const uint32_t dimension, 
+    const GridPixel& mean, HashRow* rows) {
+    const uint32_t luminance = computeLuminance(mean);
+    const uint32_t grayscaleThreshold = 3 * ((uint32_t(mean.red) + uint32_t(mean.green) + 
+        uint32_t(mean.blue)) / 3);
+    for (uint32_t i = 0; i < dimension; i++) {
+        const GridPixel* pixels = normalizedGrid.getRow(i);
+        uint32_t j = 0;
+#ifdef ENGINE_SSE2
+        uint32_t planes[HASH_CHANNEL_COUNT];
+        for (; (j + BITPLANE_GROUP) <= dimension; j += BITPLANE_GROUP) {
+            computeBitplanesSSE2(pixels + j, mean, luminance, grayscaleThreshold, planes);
+            for (uint32_t c = 0; c < HASH_CHANNEL_COUNT; c++) {
+                if (Channels & (0x1u << c)) 
+                    insertBits(rows, (HashChannel) c, (i * dimension) + j, planes[c], BITPLANE_GROUP);
+            }
+        }
+#endif
+        for (; j < dimension; j++) 
+            setPixelBits<Channels>(rows, (i * dimension) + j, pixels[j], mean, luminance, grayscaleThreshold);
+    }
+}
+
+/*
+ * Accumulates per-channel bit errors of the channel set over a fixed row 
+ * count (portable popcount lowering; unrolled by the compiler).
+ */
+template <uint32_t RowCount, uint32_t Channels>
+static ENGINE_INLINE void accumulateDistance(const HashRow* hs1, const HashRow* hs2, uint32_t* errors) {
+    for (uint32_t i = 0; i < RowCount; i++) {
+        for (uint32_t c = 0; c < HASH_CHANNEL_COUNT; c++) {
+            if (Channels & (0x1u << c)) 
+                errors[c] += __builtin_popcountll(hs1[i].channelData[c] ^ hs2[i].channelData[c]);
+        }
+    }
+}
+
+/*
+ * Portable fixed-size distance kernel.
+ */
+template <uint32_t RowCount, uint32_t Channels>
+static void distanceScalar(const HashRow* hs1, const HashRow* hs2, HashDistance& distance) {
+    memset(&distance, 0, sizeof(HashDistance));
+    accumulateDistance<RowCount, Channels>(hs1, hs2, distance.channelErrors);
+}
+
+#ifdef ENGINE_X86
+
+/*
+ * Fixed-size distance kernel using the hardware POPCNT instruction.
+ */
+template <uint32_t RowCount, uint32_t Channels>
+__attribute__((target("popcnt")))
+static void distancePopcnt(const HashRow* hs1, const HashRow* hs2, HashDistance& distance) {
+    memset(&distance, 0, sizeof(HashDistance));
+    accumulateDistance<RowCount, Channels>(hs1, hs2, distance.channelErrors);
+}
+
+#endif
+
+/*
+ * Hashes with the dimension fixed at compile time.
+ */
+template <uint32_t Dimension, uint32_t Channels>
+void HashEngine<Dimension, Channels>::computeBitplanes(const PixelGrid& normalizedGrid, const GridPixel& mean, 
+    HashRow* rows) {
+    hashBitplanes<Channels>(normalizedGrid, Dimension, mean, rows);
+}
+
+/*
+ * Vector row kernel of the runtime-sized path (counts all channels, then 
+ * clears those outside the set).
+ */
+template <uint32_t RowCount, uint32_t Channels>
+static void distanceRows(const HashRow* hs1, const HashRow* hs2, HashDistance& distance) {
+    computeHashDistance(hs1, hs2, RowCount, distance);
+    for (uint32_t c = 0; c < HASH_ROW_CHANNELS; c++) {
+        if (!(Channels & (0x1u << c))) distance.channelErrors[c] = 0;
+    }
+}
+
+/*
+ * Compares with the row count fixed at compile time. Single channels are
+ * counted word by word; wider sets keep the AVX2/AVX-512 row kernels (one
+ * lane per channel) when those are selected, as unrolled scalar counting
+ * does not beat them.
+ */
+template <uint32_t Dimension, uint32_t Channels>
+void HashEngine<Dimension, Channels>::computeDistance(const HashRow* hs1, const HashRow* hs2, 
+    HashDistance& distance) {
+    static constexpr bool singleChannel = !(Channels & (Channels - 1));
+    static const DistanceKernel kernels[] = {
+        distanceScalar<rowCount, Channels>, 
+#ifdef ENGINE_X86
+        distancePopcnt<rowCount, Channels>, 
+        singleChannel ? distancePopcnt<rowCount, Channels> : distanceRows<rowCount, Channels>,
+        singleChannel ? distancePopcnt<rowCount, Channels> : distanceRows<rowCount, Channels>
+#else
+        distanceScalar<rowCount, Channels>, distanceScalar<rowCount, Channels>, 
+        distanceScalar<rowCount, Channels>
+#endif
+    };
+    kernels[getHammingKernel()](hs1, hs2, distance);
+}
+
+template <uint32_t Dimension, uint32_t Channels>
+const HashEngineOps HashEngine<Dimension, Channels>::ops = {Dimension, rowCount, 
+    HashEngine<Dimension, Channels>::computeBitplanes, HashEngine<Dimension, Channels>::computeDistance};
+
+// specialized dimensions (full channel set)
+template class HashEngine<8>;
+template class HashEngine<16>;
+template class HashEngine<32>;
+template class HashEngine<64>;
+template class HashEngine<128>;
+template class HashEngine<256>;
+
+/*
+ * Returns the specialized engine of a normalization dimension, or null if 
+ * the dimension has none (callers fall back to the runtime-sized kernels).
+ */
+const HashEngineOps* getHashEngine(const uint32_t dimension) {
+    switch (dimension) {
+        case 8: return &HashEngine<8>::ops;
+        case 16: return &HashEngine<16>::ops;
+        case 32: return &HashEngine<32>::ops;
+        case 64: return &HashEngine<64>::ops;
+        case 128: return &HashEngine<128>::ops;
+        case 256: return &HashEngine<256>::ops;
+        default: return nullptr;
+    }
+}
+
+/*
+ * Returns the specialized engine hashing into the supplied number of rows,
+ * or null if no dimension has one.
+ */
+const HashEngineOps* getHashEngineByRows(const uint32_t rowCount) {
+    switch (rowCount) {
+        case HashEngine<8>::rowCount: return &HashEngine<8>::ops;
+        case HashEngine<16>::rowCount: return &HashEngine<16>::ops;
+        case HashEngine<32>::rowCount: return &HashEngine<32>::ops;
+        case HashEngine<64>::rowCount: return &HashEngine<64>::ops;
+        case HashEngine<128>::rowCount: return &HashEngine<128>::ops;
+        case HashEngine<256>::rowCount: return &HashEngine<256>::ops;
+        default: return nullptr;
+    }
+}
+
+/*
+ * Hashes a normalized grid of any supported dimension into zeroed rows.
+ */
+void computeBitplanes(const PixelGrid& normalizedGrid, const uint32_t dimension, const GridPixel& mean, 
+    HashRow* rows) {
+    const HashEngineOps* engine = getHashEngine(dimension);
+    if (engine != nullptr) engine->computeBitplanes(normalizedGrid, mean, rows);
+    else hashBitplanes<HASH_CHANNELS_ALL>(normalizedGrid, dimension, mean, rows);
+}
@@ -0,0 +1,309 @@
+#include <algorithm>
+#include <string.h>
+#include "hash/hamming.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAMMING_X86
+#endif
+using namespace std;
+
+typedef uint32_t (*WordKernel)(const uint64_t*, const uint64_t*, const size_t);
+typedef void (*RowKernel)(const HashRow*, const HashRow*, const size_t, uint32_t*);
+typedef uint32_t (*ChannelKernel)(const HashRow*, const HashRow*, const size_t, const HashChannel, 
+    const uint32_t);
+
+/*
+ * Portable word kernel (compiler chooses popcount lowering).
+ */
+static uint32_t wordDistanceScalar(const uint64_t* hs1, const uint64_t* hs2, const size_t wordCount) {
+    uint32_t distance = 0;
+    for (size_t i = 0; i < wordCount; i++) distance += __builtin_popcountll(hs1[i] ^ hs2[i]);
+    return distance;
+}
+
+/*
+ * Portable row kernel accumulating per-channel distances.
+ */
+static void rowDistanceScalar(const HashRow* hs1, const HashRow* hs2, const size_t rowCount, 
+    uint32_t* errors) {
+    for (size_t i = 0; i < rowCount; i++) {
+        for (uint32_t c = 0; c < HASH_ROW_CHANNELS; c++) 
+            errors[c] += __builtin_popcountll(hs1[i].channelData[c] ^ hs2[i].channelData[c]);
+    }
+}
+
+/*
+ * Portable channel kernel: counts one channel's words, stopping once the
+ * count passes the limit (checked every CHANNEL_CHECK_ROWS rows).
+ */
+static uint32_t channelDistanceScalar(const HashRow* hs1, const HashRow* hs2, const size_t rowCount, 
+    const HashChannel channel, const uint32_t limit) {
+    uint32_t distance = 0;
+    for (size_t i = 0; i < rowCount; i += CHANNEL_CHECK_ROWS) {
+        const size_t end = min(i + CHANNEL_CHECK_ROWS, rowCount);
+        for (size_t j = i; j < end; j++) 
+            distance += __builtin_popcountll(hs1[j].channelData[channel] ^ hs2[j].channelData[channel]);
+        if (distance > limit) break;
+    }
+    return distance;
+}
+
+#ifdef HAMMING_X86
+
+/*
+ * Word kernel using the hardware POPCNT instruction.
+ */
+__attribute__((target("popcnt")))
+static uint32_t wordDistancePopcnt(const uint64_t* hs1, const uint64_t* hs2, const size_t wordCount) {
+    uint64_t distance = 0;
+    for (size_t i = 0; i < wordCount; i++) distance += _mm_popcnt_u64(hs1[i] ^ hs2[i]);
+    return distance;
+}
+
+/*
+ * Row kernel using the hardware POPCNT instruction.
+ */
+__attribute__((target("popcnt")))
+static void rowDistancePopcnt(const HashRow* hs1, const HashRow* hs2, const size_t rowCount, 
+    uint32_t* errors) {
+    for (size_t i = 0; i < rowCount; i++) {
+        for (uint32_t c = 0; c < HASH_ROW_CHANNELS; c++) 
+            errors[c] += _mm_popcnt_u64(hs1[i].channelData[c] ^ hs2[i].channelData[c]);
+    }
+}
+
+/*
+ * Channel kernel using the hardware POPCNT instruction (one word per row,
+ * so the vector levels use it as well).
+ */
+__attribute__((target("popcnt")))
+static uint32_t channelDistancePopcnt(const HashRow* hs1, const HashRow* hs2, const size_t rowCount, 
+    const HashChannel channel, const uint32_t limit) {
+    uint32_t distance = 0;
+    for (size_t i = 0; i < rowCount; i += CHANNEL_CHECK_ROWS) {
+        const size_t end = min(i + CHANNEL_CHECK_ROWS, rowCount);
+        for (size_t j = i; j < end; j++) 
+            distance += _mm_popcnt_u64(hs1[j].channelData[channel] ^ hs2[j].channelData[channel]);
+        if (distance > limit) break;
+    }
+    return distance;
+}
+
+/*
+ * Counts set bits of each 64-bit lane with a nibble lookup table.
+ */
+__attribute__((target("avx2")))
+static inline __m256i popcountLanesAVX2(const __m256i v) {
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i lowMask = _mm256_set1_epi8(0x0F);
+    const __m256i low = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, lowMask));
+    const __m256i high = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), lowMask));
+    return _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256());
+}
+
+/*
+ * Word kernel counting four words per step with AVX2.
+ */
+__attribute__((target("avx2")))
+static uint32_t wordDistanceAVX2(const uint64_t* hs1, const uint64_t* hs2, const size_t wordCount) {
+    __m256i accumulator = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; (i + 4) <= wordCount; i += 4) {
+        const __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*) (hs1 + i)), 
+            _mm256_loadu_si256((const __m256i*) (hs2 + i)));
+        accumulator = _mm256_add_epi64(accumulator, popcountLanesAVX2(x));
+    }
+
+    // reduce lanes and finish tail
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*) lanes, accumulator);
+    uint64_t distance = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for (; i < wordCount; i++) distance += __builtin_popcountll(hs1[i] ^ hs2[i]);
+    return distance;
+}
+
+/*
+ * Row kernel keeping one AVX2 lane per channel.
+ */
+__attribute__((target("avx2")))
+static void rowDistanceAVX2(const HashRow* hs1, const HashRow* hs2, const size_t rowCount, 
+    uint32_t* errors) {
+    __m256i lowChannels = _mm256_setzero_si256(), highChannels = _mm256_setzero_si256();
+    for (size_t i = 0; i < rowCount; i++) {
+        const __m256i* row1 = (const __m256i*) hs1[i].channelData;
+        const __m256i* row2 = (const __m256i*) hs2[i].channelData;
+        lowChannels = _mm256_add_epi64(lowChannels, popcountLanesAVX2(
+            _mm256_xor_si256(_mm256_load_si256(row1), _mm256_load_si256(row2))));
+        highChannels = _mm256_add_epi64(highChannels, popcountLanesAVX2(
+            _mm256_xor_si256(_mm256_load_si256(row1 + 1), _mm256_load_si256(row2 + 1))));
+    }
+
+    // add lane counts to channel errors
+    uint64_t lanes[HASH_ROW_CHANNELS];
+    _mm256_storeu_si256((__m256i*) lanes, lowChannels);
+    _mm256_storeu_si256((__m256i*) (lanes + 4), highChannels);
+    for (uint32_t c = 0; c < HASH_ROW_CHANNELS; c++) errors[c] += lanes[c];
+}
+
+/*
+ * Word kernel counting eight words per step with AVX-512 VPOPCNTDQ.
+ */
+__attribute__((target("avx512f,avx512vpopcntdq")))
+static uint32_t wordDistanceAVX512(const uint64_t* hs1, const uint64_t* hs2, const size_t wordCount) {
+    __m512i accumulator = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; (i + 8) <= wordCount; i += 8) {
+        const __m512i x = _mm512_xor_si512(_mm512_loadu_si512(hs1 + i), _mm512_loadu_si512(hs2 + i));
+        accumulator = _mm512_add_epi64(accumulator, _mm512_popcnt_epi64(x));
+    }
+
+    // masked tail load
+    if (i < wordCount) {
+        const __mmask8 tailMask = (__mmask8) ((1u << (wordCount - i)) - 1);
+        const __m512i x = _mm512_xor_si512(_mm512_maskz_loadu_epi64(tailMask, hs1 + i), 
+            _mm512_maskz_loadu_epi64(tailMask, hs2 + i));
+        accumulator = _mm512_add_epi64(accumulator, _mm512_popcnt_epi64(x));
+    }
+
+    // reduce lanes
+    uint64_t lanes[8], distance = 0;
+    _mm512_storeu_si512(lanes, accumulator);
+    for (uint32_t c = 0; c < 8; c++) distance += lanes[c];
+    return distance;
+}
+
+/*
+ * Row kernel keeping one AVX-512 lane per channel (one row per register).
+ */
+__attribute__((target("avx512f,avx512vpopcntdq")))
+static void rowDistanceAVX512(const HashRow* hs1, const HashRow* hs2, const size_t rowCount, 
+    uint32_t* errors) {
+    __m512i channels = _mm512_setzero_si512();
+    for (size_t i = 0; i < rowCount; i++) {
+        const __m512i x = _mm512_xor_si512(_mm512_load_si512(hs1[i].channelData), 
+            _mm512_load_si512(hs2[i].channelData));
+        channels = _mm512_add_epi64(channels, _mm512_popcnt_epi64(x));
+    }
+
+    // add lane counts to channel errors
+    uint64_t lanes[HASH_ROW_CHANNELS];
+    _mm512_storeu_si512(lanes, channels);
+    for (uint32_t c = 0; c < HASH_ROW_CHANNELS; c++) errors[c] += lanes[c];
+}
+
+#endif
+
+/*
+ * Reports whether the running CPU can execute the indicated kernel.
+ */
+static bool kernelSupported(const HammingKernel kernel) {
+#ifdef HAMMING_X86
+    __builtin_cpu_init();
+    switch (kernel) {
+        case HAMMING_KERNEL_SCALAR: return true;
+        case HAMMING_KERNEL_POPCNT: return __builtin_cpu_supports("popcnt");
+        case HAMMING_KERNEL_AVX2: return __builtin_cpu_supports("avx2");
+        case HAMMING_KERNEL_AVX512: return __builtin_cpu_supports("avx512f") && 
+            __builtin_cpu_supports("avx512vpopcntdq");
+    }
+    return false;
+#else
+    return kernel == HAMMING_KERNEL_SCALAR;
+#endif
+}
+
+/*
+ * Selected kernel state, resolved to the widest supported kernel on first use.
+ */
+static struct KernelState {
+    HammingKernel kernel;
+    WordKernel wordKernel;
+    RowKernel rowKernel;
+    ChannelKernel channelKernel;
+    KernelState(void) : kernel(HAMMING_KERNEL_SCALAR), wordKernel(wordDistanceScalar), 
+        rowKernel(rowDistanceScalar), channelKernel(channelDistanceScalar) {
+        if (kernelSupported(HAMMING_KERNEL_AVX512)) setHammingKernel(HAMMING_KERNEL_AVX512, *this);
+        else if (kernelSupported(HAMMING_KERNEL_AVX2)) setHammingKernel(HAMMING_KERNEL_AVX2, *this);
+        else if (kernelSupported(HAMMING_KERNEL_POPCNT)) setHammingKernel(HAMMING_KERNEL_POPCNT, *this);
+    }
+    static void setHammingKernel(const HammingKernel kernel, KernelState& state) {
+        state.kernel = kernel;
+        switch (kernel) {
+#ifdef HAMMING_X86
+            case HAMMING_KERNEL_POPCNT: 
+                state.wordKernel = wordDistancePopcnt; 
+                state.rowKernel = rowDistancePopcnt; 
+                state.channelKernel = channelDistancePopcnt; 
+                break;
+            case HAMMING_KERNEL_AVX2: 
+                state.wordKernel = wordDistanceAVX2; 
+                state.rowKernel = rowDistanceAVX2; 
+                state.channelKernel = channelDistancePopcnt; 
+                break;
+            case HAMMING_KERNEL_AVX512: 
+                state.wordKernel = wordDistanceAVX512; 
+                state.rowKernel = rowDistanceAVX512; 
+                state.channelKernel = channelDistancePopcnt; 
+                break;
+#endif
+            default: 
+                state.wordKernel = wordDistanceScalar; 
+                state.rowKernel = rowDistanceScalar;
+                state.channelKernel = channelDistanceScalar;
+        }
+    }
+} kernelState;
+
+/*
+ * Returns the kernel selected for Hamming distance computation.
+ */
+HammingKernel getHammingKernel(void) {
+    return kernelState.kernel;
+}
+
+/*
+ * Overrides runtime kernel selection (benchmarking and verification).
+ */
+void setHammingKernel(const HammingKernel kernel) {
+    if (!kernelSupported(kernel)) throw "Hamming Error: Kernel not supported on this CPU.";
+    KernelState::setHammingKernel(kernel, kernelState);
+}
+
+/*
+ * Computes Hamming distance between two flat word arrays.
+ */
+uint32_t computeHammingDistance(const uint64_t* hs1, const uint64_t* hs2, const size_t wordCount) {
+    return kernelState.wordKernel(hs1, hs2, wordCount);
+}
+
+/*
+ * Computes per-channel Hamming distances between two interleaved hashes.
+ */
+void computeHashDistance(const HashRow* hs1, const HashRow* hs2, const size_t rowCount, 
+    HashDistance& distance) {
+    memset(&distance, 0, sizeof(HashDistance));
+    kernelState.rowKernel(hs1, hs2, rowCount, distance.channelErrors);
+}
+
+/*
+ * Computes one channel's Hamming distance between two interleaved hashes. 
+ * Counting stops early once the distance exceeds the limit, so any result
+ * above the limit is only a lower bound.
+ */
+uint32_t computeChannelDistance(const HashRow* hs1, const HashRow* hs2, const size_t rowCount, 
+    const HashChannel channel, const uint32_t limit) {
+    return kernelState.channelKernel(hs1, hs2, rowCount, channel, limit);
+}
+
+/*
+ * Computes per-channel Hamming distances between one query hash and a 
+ * contiguous array of stored hashes (each rowCount rows long).
+ */
+void computeHashDistanceBatch(const HashRow* query, const HashRow* stored, const size_t hashCount, 
+    const size_t rowCount, HashDistance* distances) {
+    const RowKernel rowKernel = kernelState.rowKernel;
+    memset(distances, 0, sizeof(HashDistance) * hashCount);
+    for (size_t i = 0; i < hashCount; i++, stored += rowCount)
+        rowKernel(query, stored, rowCount, distances[i].channelErrors);
+}
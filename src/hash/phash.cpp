@@ -2,26 +2,27 @@
 #include <cmath>
 #include <iostream>
 #include <bitset>
+#include <algorithm>
 #include <string.h>
 #include "hash/phash.h"
 using namespace std;
 
 /*
- * Initializes error weights and dynamic grid memory.
+ * Initializes error weights and dynamic grid memory. Hash rows and scratch
+ * grids come from the supplied pool when present (and must not outlive it).
  */
 ImagePerceptualHash::ImagePerceptualHash(const PixelGrid& grid, 
-    const uint32_t normalizationSize) : 
-    PerceptualHash(grid), normalizationDimension(normalizationSize), 
-    hashColorLength(pow(normalizationDimension, 2) / HASH_SEGMENT_SIZE) {
-
-    // allocate dynamic memory
-    result.redData.reset(new vector<uint64_t>(hashColorLength));
-    result.greenData.reset(new vector<uint64_t>(hashColorLength));
-    result.blueData.reset(new vector<uint64_t>(hashColorLength));
-    result.luminanceData.reset(new vector<uint64_t>(hashColorLength));
-    result.grayscaleData.reset(new vector<uint64_t>(hashColorLength));
-    result.combinedData1.reset(new vector<uint64_t>(hashColorLength));
-    result.combinedData2.reset(new vector<uint64_t>(hashColorLength));
+    const uint32_t normalizationSize, ImageMetrics* metrics, BufferPool* pool) : 
+    PerceptualHash(grid), dirtyLogPosition(0), 
+    incrementalFlag(false), normalizationDimension(normalizationSize), 
+    hashColorLength(pow(normalizationDimension, 2) / HASH_SEGMENT_SIZE), metrics(metrics), pool(pool) {
+
+    // allocate contiguous hash rows (zeroed when hashed)
+    if (!hashColorLength) throw "ImagePerceptualHash Error: Normalization dimension too small.";
+    if (normalizationDimension % HASH_DIMENSION_STEP) 
+        throw "ImagePerceptualHash Error: Normalization dimension must be a multiple of 8.";
+    hashRows = PoolBuffer<HashRow>(hashColorLength, pool, false);
+    if (!hashRows.isRecycled()) recordAllocation(metrics, sizeof(HashRow) * hashColorLength);
 }
 
 /*
@@ -29,50 +30,28 @@ ImagePerceptualHash::ImagePerceptualHash(const PixelGrid& grid,
  */
 IPHSErrorDiagnosis ImagePerceptualHash::compareHashes(ImagePerceptualHash& hs1, ImagePerceptualHash& hs2,
     const bool verbose, const uint32_t normalizationDimension) {
-    uint8_t hashColorLength = pow(normalizationDimension, 2) / HASH_SEGMENT_SIZE;
-    uint32_t redError = 0, greenError = 0, blueError = 0, luminanceError = 0, 
-        grayscaleError = 0, combinedError1 = 0, combinedError2 = 0;
-
-    // count bit errors
-    for (uint8_t i = 0; i < hashColorLength; i++) {
-        for (uint8_t j = 0; j < HASH_SEGMENT_SIZE; j++) {
-
-            // get red error
-            bool set1 = ((*(hs1.getHash().redData))[i] & (0x1 << j)) != 0;
-            bool set2 = ((*(hs2.getHash().redData))[i] & (0x1 << j)) != 0;
-            if (set1 != set2) redError++;
-
-            // get green error
-            set1 = ((*(hs1.getHash().greenData))[i] & (0x1 << j)) != 0;
-            set2 = ((*(hs2.getHash().greenData))[i] & (0x1 << j)) != 0;
-            if (set1 != set2) greenError++;
-
-            // get blue error
-            set1 = ((*(hs1.getHash().blueData))[i] & (0x1 << j)) != 0;
-            set2 = ((*(hs2.getHash().blueData))[i] & (0x1 << j)) != 0;
-            if (set1 != set2) blueError++;
-
-            // get luminance error
-            set1 = ((*(hs1.getHash().luminanceData))[i] & (0x1 << j)) != 0;
-            set2 = ((*(hs2.getHash().luminanceData))[i] & (0x1 << j)) != 0;
-            if (set1 != set2) luminanceError++;
-
-            // get grayscale error
-            set1 = ((*(hs1.getHash().grayscaleData))[i] & (0x1 << j)) != 0;
-            set2 = ((*(hs2.getHash().grayscaleData))[i] & (0x1 << j)) != 0;
-            if (set1 != set2) grayscaleError++;
-
-            // get combined 1 error
-            set1 = ((*(hs1.getHash().combinedData1))[i] & (0x1 << j)) != 0;
-            set2 = ((*(hs2.getHash().combinedData1))[i] & (0x1 << j)) != 0;
-            if (set1 != set2) combinedError1++;
-
-            // get combined 2 error
-            set1 = ((*(hs1.getHash().combinedData2))[i] & (0x1 << j)) != 0;
-            set2 = ((*(hs2.getHash().combinedData2))[i] & (0x1 << j)) != 0;
-            if (set1 != set2) combinedError2++;
-        }
-    }
+    const uint32_t hashColorLength = pow(normalizationDimension, 2) / HASH_SEGMENT_SIZE;
+    if ((hs1.getHashRowCount() != hashColorLength) || (hs2.getHashRowCount() != hashColorLength))
+        throw "ImagePerceptualHash Error: Hash size does not match normalization dimension.";
+    return compareHashes(hs1.getHashRows(), hs2.getHashRows(), hashColorLength, verbose);
+}
+
+/*
+ * Calculates and analyzes error between two interleaved hash records.
+ */
+IPHSErrorDiagnosis ImagePerceptualHash::compareHashes(const HashRow* hs1, const HashRow* hs2, 
+    const uint32_t hashColorLength, const bool verbose) {
+
+    // count bit errors per channel (fixed-size kernel for specialized dimensions)
+    HashDistance distance;
+    const HashEngineOps* engine = getHashEngineByRows(hashColorLength);
+    if (engine != nullptr) engine->computeDistance(hs1, hs2, distance);
+    else computeHashDistance(hs1, hs2, hashColorLength, distance);
+    const uint32_t* errors = distance.channelErrors;
+    const uint32_t redError = errors[RED_CHANNEL], greenError = errors[GREEN_CHANNEL], 
+        blueError = errors[BLUE_CHANNEL], luminanceError = errors[LUMINANCE_CHANNEL], 
+        grayscaleError = errors[GRAYSCALE_CHANNEL], combinedError1 = errors[COMBINED1_CHANNEL], 
+        combinedError2 = errors[COMBINED2_CHANNEL];
 
     // compute error percentages
     IPHSErrorDiagnosis errorDiagnosis;
@@ -99,275 +78,409 @@ IPHSErrorDiagnosis ImagePerceptualHash::compareHashes(ImagePerceptualHash& hs1,
 }
 
 /*
- * Computes and sets the general image perceptual hash.
+ * Returns match criteria with one threshold on every channel, evaluating
+ * luminance first, then grayscale, the combined hashes and the RGB channels.
+ */
+IPHSMatchCriteria ImagePerceptualHash::getMatchCriteria(const float threshold) {
+    IPHSMatchCriteria criteria = {{}, {LUMINANCE_CHANNEL, GRAYSCALE_CHANNEL, COMBINED1_CHANNEL, 
+        COMBINED2_CHANNEL, RED_CHANNEL, GREEN_CHANNEL, BLUE_CHANNEL}, HASH_CHANNEL_COUNT};
+    for (uint32_t c = 0; c < HASH_CHANNEL_COUNT; c++) criteria.thresholds[c] = threshold;
+    return criteria;
+}
+
+/*
+ * Decides whether two perceptual image hashes match under the criteria.
+ */
+IPHSMatchResult ImagePerceptualHash::matchHashes(ImagePerceptualHash& hs1, ImagePerceptualHash& hs2, 
+    const IPHSMatchCriteria& criteria) {
+    if (hs1.getHashRowCount() != hs2.getHashRowCount())
+        throw "ImagePerceptualHash Error: Hash sizes do not match.";
+    return matchHashes(hs1.getHashRows(), hs2.getHashRows(), hs1.getHashRowCount(), criteria);
+}
+
+/*
+ * Decides whether two interleaved hash records match: channels are counted
+ * in the criteria order, each against its bit budget, and counting stops at
+ * the first channel that exceeds its budget (reported as the reject stage).
+ */
+IPHSMatchResult ImagePerceptualHash::matchHashes(const HashRow* hs1, const HashRow* hs2, 
+    const uint32_t hashColorLength, const IPHSMatchCriteria& criteria) {
+    if (criteria.stageCount > HASH_CHANNEL_COUNT) throw "ImagePerceptualHash Error: Invalid match stage count.";
+    IPHSMatchResult result = {true, MATCH_ACCEPTED, RED_CHANNEL, 0, {}};
+    for (uint32_t s = 0; s < criteria.stageCount; s++) {
+        const HashChannel channel = criteria.order[s];
+        if ((channel >= HASH_CHANNEL_COUNT) || (criteria.thresholds[channel] < 0)) 
+            throw "ImagePerceptualHash Error: Invalid match criteria.";
+        const uint32_t budget = criteria.thresholds[channel] * ((double) HASH_SEGMENT_SIZE * hashColorLength);
+        result.stageErrors[s] = computeChannelDistance(hs1, hs2, hashColorLength, channel, budget);
+        result.evaluatedStages++;
+        if (result.stageErrors[s] > budget) {
+            result.matched = false;
+            result.rejectStage = s;
+            result.rejectChannel = channel;
+            break;
+        }
+    }
+    return result;
+}
+
+/*
+ * Copies interleaved hash rows into contiguous storage for batch comparison.
+ */
+void ImagePerceptualHash::copyHashRows(HashRow* rows) const {
+    memcpy(rows, getHashRows(), sizeof(HashRow) * hashColorLength);
+}
+
+/*
+ * Returns flat hash record (default normalization dimension only).
+ */
+IPHSRecord ImagePerceptualHash::getHashRecord(void) const {
+    if (hashColorLength != DEFAULT_HASH_ROW_COUNT) 
+        throw "ImagePerceptualHash Error: Hash record requires default normalization dimension.";
+    IPHSRecord record;
+    copyHashRows(record.rows);
+    return record;
+}
+
+/*
+ * Computes and sets the general image perceptual hash, summing blocks
+ * straight from the grid (no summed-area tables for a single dimension).
  */
 void ImagePerceptualHash::executeHash(void) {
     if (computedFlag) throw "ImagePerceptualHash Error: Hash already computed.";
+    IPHSUpdateState state;
+    hashGrid(nullptr, state, false);
+}
 
-    // zero hash memory
-    memset(&((*(result.redData)).front()), 0, sizeof(uint64_t) * (*(result.redData)).size());
-    memset(&((*(result.greenData)).front()), 0, sizeof(uint64_t) * (*(result.greenData)).size());
-    memset(&((*(result.blueData)).front()), 0, sizeof(uint64_t) * (*(result.blueData)).size());
-    memset(&((*(result.luminanceData)).front()), 0, sizeof(uint64_t) * (*(result.luminanceData)).size());
-    memset(&((*(result.grayscaleData)).front()), 0, sizeof(uint64_t) * (*(result.grayscaleData)).size());
-    memset(&((*(result.combinedData1)).front()), 0, sizeof(uint64_t) * (*(result.combinedData1)).size());
-    memset(&((*(result.combinedData2)).front()), 0, sizeof(uint64_t) * (*(result.combinedData2)).size());
+/*
+ * Computes and sets the image perceptual hash from prebuilt summed-area tables
+ * of the grid, letting one integral grid serve several dimensions.
+ */
+void ImagePerceptualHash::executeHash(const IntegralGrid& integralGrid) {
+    if (computedFlag) throw "ImagePerceptualHash Error: Hash already computed.";
+    if ((integralGrid.getGridHeight() != grid.getGridHeight()) || 
+        (integralGrid.getGridWidth() != grid.getGridWidth()))
+        throw "ImagePerceptualHash Error: Integral grid does not match image grid.";
+    IPHSUpdateState state;
+    hashGrid(&integralGrid, state, false);
+}
 
-    // iteratively normalize grid RGB 
-    PixelGrid normalizedGrid({normalizationDimension, normalizationDimension});
-    GridPixel meanRGBValues = normalizeGridRGB(grid, normalizedGrid);
+/*
+ * Normalizes the grid into the state (from summed-area tables when supplied,
+ * otherwise by direct block sums, kept in the state on request) and hashes it.
+ */
+void ImagePerceptualHash::hashGrid(const IntegralGrid* integralGrid, IPHSUpdateState& state, 
+    const bool keepSums) {
+
+    // zero hash memory and note grid edits so far
+    memset(hashRows.get(), 0, sizeof(HashRow) * hashColorLength);
+    vector<uint32_t> dirtyTiles;
+    dirtyLogPosition = grid.collectDirtyTiles(grid.getDirtyLogPosition(), dirtyTiles);
+
+    // normalize grid RGB from block means (every pixel is written)
+    state.normalizedGrid.reset(new PixelGrid({normalizationDimension, normalizationDimension}, pool, false));
+    if (!state.normalizedGrid->isRecycled()) recordAllocation(metrics, state.normalizedGrid->getGridBytes());
+    {
+        StageTimer timer(metrics, NORMALIZE_STAGE);
+        state.meanRGBValues = (integralGrid != nullptr) ? normalizeGridRGB(*integralGrid, state) : 
+            normalizeGridRGB(state, keepSums);
+    }
 
     // compute RGB hash values
-    computeRGBHash(normalizedGrid, meanRGBValues);
+    StageTimer timer(metrics, HASH_STAGE);
+    computeRGBHash(*state.normalizedGrid, state.meanRGBValues);
+    incrementalFlag = true;
     computedFlag = true;
 }
 
 /*
- * Prints bit image of RGB perceptual image hash.
+ * Re-hashes after pixel edits tracked by the grid. Only normalized blocks 
+ * covering tiles edited since the last hash are re-summed from the grid and
+ * only their bits are rewritten, unless the change moved the image mean 
+ * (then every bit is recomputed from the kept normalized grid). Hashes the 
+ * grid in full if not yet computed, and again on the first edits after a 
+ * plain hash, keeping the block sums from then on.
  */
-void ImagePerceptualHash::printHashBits(void) const {
-    if (!computedFlag) throw "ImagePerceptualHash Error: Hash not yet computed.";
-
-    // print red hash bits
-    cout << endl << "Red Hash:" << endl << flush;
-    for (uint8_t i = 0; i < hashColorLength; i++) {
-        bitset<64> bucket((*(result.redData))[i]);
-        cout << bucket << flush;
+void ImagePerceptualHash::updateHash(void) {
+    if (!computedFlag) {
+        executeHash();
+        return;
     }
-
-    // print green hash bits
-    cout << endl << endl << "Green Hash:" << endl << flush;
-    for (uint8_t i = 0; i < hashColorLength; i++) {
-        bitset<64> bucket((*(result.greenData))[i]);
-        cout << bucket << flush;
+    if (!incrementalFlag) throw "ImagePerceptualHash Error: Hash not computed from an image grid.";
+    vector<uint32_t> dirtyTiles;
+    dirtyLogPosition = grid.collectDirtyTiles(dirtyLogPosition, dirtyTiles);
+    if (dirtyTiles.empty()) return;
+
+    // keep update state from the first edits on
+    if (!updateState) {
+        updateState.reset(new IPHSUpdateState());
+        hashGrid(nullptr, *updateState, true);
+        return;
     }
-
-    // print blue hash bits
-    cout << endl << endl << "Blue Hash:" << endl << flush;
-    for (uint8_t i = 0; i < hashColorLength; i++) {
-        bitset<64> bucket((*(result.blueData))[i]);
-        cout << bucket << flush;
+    IPHSUpdateState& state = *updateState;
+    const vector<size_t>& rowBoundaries = state.rowBoundaries;
+    const vector<size_t>& columnBoundaries = state.columnBoundaries;
+
+    // map dirty tiles onto the normalized blocks they overlap
+    const size_t tileColumns = grid.getDirtyTileColumns();
+    vector<uint8_t> dirtyFlags(normalizationDimension * normalizationDimension, 0);
+    vector<uint32_t> dirtyBlocks;
+    for (const uint32_t tile : dirtyTiles) {
+        const size_t top = (tile / tileColumns) * DIRTY_TILE_SIZE, left = (tile % tileColumns) * DIRTY_TILE_SIZE;
+        const size_t bottom = min(top + DIRTY_TILE_SIZE, grid.getGridHeight()) - 1;
+        const size_t right = min(left + DIRTY_TILE_SIZE, grid.getGridWidth()) - 1;
+        const size_t firstRow = (upper_bound(rowBoundaries.begin(), rowBoundaries.end(), top) - 
+            rowBoundaries.begin()) - 1, lastRow = (upper_bound(rowBoundaries.begin(), rowBoundaries.end(), 
+            bottom) - rowBoundaries.begin()) - 1;
+        const size_t firstColumn = (upper_bound(columnBoundaries.begin(), columnBoundaries.end(), left) - 
+            columnBoundaries.begin()) - 1, lastColumn = (upper_bound(columnBoundaries.begin(), 
+            columnBoundaries.end(), right) - columnBoundaries.begin()) - 1;
+        for (size_t row = firstRow; row <= lastRow; row++) {
+            for (size_t col = firstColumn; col <= lastColumn; col++) {
+                const uint32_t position = (row * normalizationDimension) + col;
+                if (dirtyFlags[position]) continue;
+                dirtyFlags[position] = 1;
+                dirtyBlocks.push_back(position);
+            }
+        }
     }
 
-    // print luminance hash bits
-    cout << endl << endl << "Luminance Hash:" << endl << flush;
-    for (uint8_t i = 0; i < hashColorLength; i++) {
-        bitset<64> bucket((*(result.luminanceData))[i]);
-        cout << bucket << flush;
+    // re-sum dirty blocks and carry their change into the image sum
+    {
+        StageTimer timer(metrics, NORMALIZE_STAGE);
+        for (const uint32_t position : dirtyBlocks) {
+            const uint32_t row = position / normalizationDimension, col = position % normalizationDimension;
+            GridSum sum = {0, 0, 0};
+            for (size_t i = rowBoundaries[row]; i < rowBoundaries[row + 1]; i++) {
+                const GridPixel* pixels = grid.getRow(i);
+                uint32_t red = 0, green = 0, blue = 0;
+                for (size_t j = columnBoundaries[col]; j < columnBoundaries[col + 1]; j++) {
+                    red += pixels[j].red;
+                    green += pixels[j].green;
+                    blue += pixels[j].blue;
+                }
+                sum.red += red;
+                sum.green += green;
+                sum.blue += blue;
+            }
+            state.imageSum.red += sum.red - state.blockSums[position].red;
+            state.imageSum.green += sum.green - state.blockSums[position].green;
+            state.imageSum.blue += sum.blue - state.blockSums[position].blue;
+            state.blockSums[position] = sum;
+            const size_t blockDivisor = (rowBoundaries[row + 1] - rowBoundaries[row]) * 
+                (columnBoundaries[col + 1] - columnBoundaries[col]);
+            state.normalizedGrid->getRow(row)[col] = {uint8_t(sum.red / blockDivisor), 
+                uint8_t(sum.green / blockDivisor), uint8_t(sum.blue / blockDivisor)};
+        }
     }
 
-    // print grayscale hash bits
-    cout << endl << endl << "Grayscale Hash:" << endl << flush;
-    for (uint8_t i = 0; i < hashColorLength; i++) {
-        bitset<64> bucket((*(result.grayscaleData))[i]);
-        cout << bucket << flush;
+    // rewrite dirty block bits (all bits if the image mean moved)
+    StageTimer timer(metrics, HASH_STAGE);
+    const size_t imageDivisor = grid.getGridHeight() * grid.getGridWidth();
+    const GridPixel mean = {uint8_t(state.imageSum.red / imageDivisor), 
+        uint8_t(state.imageSum.green / imageDivisor), uint8_t(state.imageSum.blue / imageDivisor)};
+    const GridPixel& previousMean = state.meanRGBValues;
+    if ((mean.red != previousMean.red) || (mean.green != previousMean.green) || (mean.blue != previousMean.blue)) {
+        state.meanRGBValues = mean;
+        memset(hashRows.get(), 0, sizeof(HashRow) * hashColorLength);
+        computeRGBHash(*state.normalizedGrid, state.meanRGBValues);
+        return;
     }
-
-    // print combined hash 1 bits
-    cout << endl << endl << "Combined Hash 1:" << endl << flush;
-    for (uint8_t i = 0; i < hashColorLength; i++) {
-        bitset<64> bucket((*(result.combinedData1))[i]);
-        cout << bucket << flush;
+    const uint32_t luminance = computeLuminance(mean);
+    const uint8_t grayscaleMean = uint8_t((uint32_t(mean.red) + uint32_t(mean.green) + 
+        uint32_t(mean.blue)) / 3);
+    for (const uint32_t position : dirtyBlocks) {
+        setBlockBits(position, state.normalizedGrid->getRow(position / normalizationDimension)[position % 
+            normalizationDimension], mean, luminance, grayscaleMean);
     }
+}
 
-    // print combined hash 2 bits
-    cout << endl << endl << "Combined Hash 2:" << endl << flush;
-    for (uint8_t i = 0; i < hashColorLength; i++) {
-        bitset<64> bucket((*(result.combinedData2))[i]);
-        cout << bucket << flush;
-    }
+/*
+ * Computes and sets the image perceptual hash from block means streamed into
+ * an accumulator, without access to the full image grid.
+ */
+void ImagePerceptualHash::executeHash(const BlockAccumulator& accumulator) {
+    if (computedFlag) throw "ImagePerceptualHash Error: Hash already computed.";
+    if (accumulator.getNormalizationDimension() != normalizationDimension)
+        throw "ImagePerceptualHash Error: Accumulator does not match normalization dimension.";
 
-    cout << endl << flush;
+    // hash streamed block means
+    memset(hashRows.get(), 0, sizeof(HashRow) * hashColorLength);
+    StageTimer timer(metrics, HASH_STAGE);
+    computeRGBHash(accumulator.getNormalizedGrid(), accumulator.getImageMean());
+    computedFlag = true;
 }
 
 /*
- * Reduces supplied image into target grid by normalizing RGB pixel clusters.
+ * Prints bit image of RGB perceptual image hash.
  */
-GridPixel ImagePerceptualHash::normalizeGridRGB(const PixelGrid& pixelGrid, 
-    PixelGrid& normalizedGrid) const {
-    uint32_t horizontalScaleSize, verticalScaleSize, horizontalOverflow = 0, verticalOverflow = 0;
-    size_t runningRedSum = 0, runningGreenSum = 0, runningBlueSum = 0;
-
-    // initialize horizontal grid parsing parameters
-    if (!(pixelGrid.getGridWidth() % normalizationDimension)) {
-        horizontalScaleSize = pixelGrid.getGridWidth() / normalizationDimension;
-        horizontalOverflow = normalizationDimension;
-    } 
-    else {
-        horizontalScaleSize = pixelGrid.getGridWidth() / (normalizationDimension - 1);
-        horizontalOverflow = pixelGrid.getGridWidth() % (normalizationDimension - 1);
-    }
+void ImagePerceptualHash::printHashBits(void) const {
+    if (!computedFlag) throw "ImagePerceptualHash Error: Hash not yet computed.";
 
-    // initialize vertical grid parsing parameters
-    if (!(pixelGrid.getGridHeight() % normalizationDimension)) {
-        verticalScaleSize = pixelGrid.getGridHeight() / normalizationDimension;
-        verticalOverflow = normalizationDimension;
-    }
-    else {
-        verticalScaleSize = pixelGrid.getGridHeight() / (normalizationDimension - 1);
-        verticalOverflow = pixelGrid.getGridHeight() % (normalizationDimension - 1);
+    // print each channel's hash bits
+    static const char* channelNames[HASH_CHANNEL_COUNT] = {"Red Hash", "Green Hash", "Blue Hash", 
+        "Luminance Hash", "Grayscale Hash", "Combined Hash 1", "Combined Hash 2"};
+    for (uint32_t c = 0; c < HASH_CHANNEL_COUNT; c++) {
+        cout << endl << (c ? "\n" : "") << channelNames[c] << ":" << endl << flush;
+        for (uint32_t i = 0; i < hashColorLength; i++) {
+            bitset<64> bucket(hashRows[i].channelData[c]);
+            cout << bucket << flush;
+        }
     }
 
-    // build reduced grid
-    for (uint32_t row = 0; row < (normalizationDimension - 1); row++) {
-        for (uint32_t col = 0; col < (normalizationDimension - 1); col++) {
-
-            // take RGB pixel sums for block
-            size_t blockSumRed = 0, blockSumGreen = 0, blockSumBlue = 0;
-            for (uint32_t i = 1; i <= verticalScaleSize; i++) {
-                for (uint32_t j = 1; j <= horizontalScaleSize; j++) {
-                    GridPixel& pixel = pixelGrid.getPixel({(row * verticalScaleSize) + i, 
-                        (col * horizontalScaleSize) + j});
-                    blockSumRed += pixel.red;
-                    blockSumGreen += pixel.green;
-                    blockSumBlue += pixel.blue;
-                }
-            }
-
-            // update running sums
-            runningRedSum += blockSumRed;
-            runningGreenSum += blockSumGreen;
-            runningBlueSum += blockSumBlue;
+    cout << endl << flush;
+}
 
-            // calculate block mean
-            uint32_t blockDivisor = verticalScaleSize * horizontalScaleSize;
-            normalizedGrid.setPixel({row + 1, col + 1}, {uint8_t(blockSumRed / blockDivisor), 
-                uint8_t(blockSumGreen / blockDivisor), uint8_t(blockSumBlue / blockDivisor)});
-        }
-    } 
-
-    // build overflow column
-    const uint32_t overflowColumn = horizontalScaleSize * (normalizationDimension - 1);
-    for (uint32_t row = 0; row < (normalizationDimension - 1); row++) {
-
-        // take RGB pixel sums for overflow block
-        size_t blockSumRed = 0, blockSumGreen = 0, blockSumBlue = 0;
-        for (uint32_t i = 1; i <= verticalScaleSize; i++) {
-            for (uint32_t j = 1; j <= horizontalOverflow; j++) {
-                GridPixel& pixel = pixelGrid.getPixel({(row * verticalScaleSize) + i, 
-                    overflowColumn + j});
-                blockSumRed += pixel.red;
-                blockSumGreen += pixel.green;
-                blockSumBlue += pixel.blue;
-            }
-        }
+/*
+ * Splits a grid side into normalization block boundaries. Evenly divisible
+ * sides use equal blocks; otherwise the final block absorbs the remainder.
+ */
+void ImagePerceptualHash::computeBlockBoundaries(const size_t length, const uint32_t dimension, 
+    vector<size_t>& boundaries) {
+    if ((dimension < 2) || (length < dimension)) 
+        throw "ImagePerceptualHash Error: Grid smaller than normalization dimension.";
+    size_t scaleSize = length / dimension;
+    if (length % dimension) {
+        scaleSize = length / (dimension - 1);
+        if (!(length % (dimension - 1))) scaleSize = (length - 1) / (dimension - 1);
+    }
 
-        // update running sums
-        runningRedSum += blockSumRed;
-        runningGreenSum += blockSumGreen;
-        runningBlueSum += blockSumBlue;
+    // set block boundaries
+    boundaries.resize(dimension + 1);
+    for (uint32_t i = 0; i < dimension; i++) boundaries[i] = i * scaleSize;
+    boundaries[dimension] = length;
+}
 
-        // calculate block mean
-        uint32_t overflowDivisor = verticalScaleSize * horizontalOverflow;
-        normalizedGrid.setPixel({row + 1, normalizationDimension}, {uint8_t(blockSumRed / overflowDivisor), 
-            uint8_t(blockSumGreen / overflowDivisor), uint8_t(blockSumBlue / overflowDivisor)});
+/*
+ * Reduces supplied image into target grid by normalizing RGB pixel clusters.
+ */
+GridPixel ImagePerceptualHash::normalizeGridRGB(const IntegralGrid& integralGrid, 
+    IPHSUpdateState& state) {
+    const vector<size_t>& rowBoundaries = state.rowBoundaries;
+    const vector<size_t>& columnBoundaries = state.columnBoundaries;
+    computeBlockBoundaries(integralGrid.getGridHeight(), normalizationDimension, state.rowBoundaries);
+    computeBlockBoundaries(integralGrid.getGridWidth(), normalizationDimension, state.columnBoundaries);
+
+    // build reduced grid from constant-time block sums
+    for (uint32_t row = 0; row < normalizationDimension; row++) {
+        GridPixel* pixels = state.normalizedGrid->getRow(row);
+        const size_t blockHeight = rowBoundaries[row + 1] - rowBoundaries[row];
+        for (uint32_t col = 0; col < normalizationDimension; col++) {
+            const size_t blockWidth = columnBoundaries[col + 1] - columnBoundaries[col];
+            if (!blockHeight || !blockWidth) throw "IntegralGrid Error: Invalid target block.";
+            const GridSum sum = integralGrid.getBlockSum(rowBoundaries[row], columnBoundaries[col], 
+                blockHeight, blockWidth);
+            const size_t blockDivisor = blockHeight * blockWidth;
+            pixels[col] = {uint8_t(sum.red / blockDivisor), uint8_t(sum.green / blockDivisor), 
+                uint8_t(sum.blue / blockDivisor)};
+        }
     }
 
-    // build overflow row
-    const uint32_t overflowRow = verticalScaleSize * (normalizationDimension - 1);
-    for (uint32_t col = 0; col < (normalizationDimension - 1); col++) {
-
-        // take RGB pixel sums for overflow block
-        size_t blockSumRed = 0, blockSumGreen = 0, blockSumBlue = 0;
-        for (uint32_t i = 1; i <= verticalOverflow; i++) {
-            for (uint32_t j = 1; j <= horizontalScaleSize; j++) {
-                GridPixel& pixel = pixelGrid.getPixel({overflowRow + i, 
-                    (col * horizontalScaleSize) + j});
-                blockSumRed += pixel.red;
-                blockSumGreen += pixel.green;
-                blockSumBlue += pixel.blue;
+    // compute image mean
+    const GridSum& imageSum = state.imageSum = integralGrid.getGridSum();
+    const size_t imageDivisor = integralGrid.getGridHeight() * integralGrid.getGridWidth();
+    return {uint8_t(imageSum.red / imageDivisor), uint8_t(imageSum.green / imageDivisor), 
+        uint8_t(imageSum.blue / imageDivisor)};
+}
+
+/*
+ * Reduces the image grid into target grid by summing each block's pixels in
+ * one pass over the grid rows (no table memory beyond one block row of sums,
+ * unless every block sum is kept for updates).
+ */
+GridPixel ImagePerceptualHash::normalizeGridRGB(IPHSUpdateState& state, const bool keepSums) {
+    const vector<size_t>& rowBoundaries = state.rowBoundaries;
+    const vector<size_t>& columnBoundaries = state.columnBoundaries;
+    computeBlockBoundaries(grid.getGridHeight(), normalizationDimension, state.rowBoundaries);
+    computeBlockBoundaries(grid.getGridWidth(), normalizationDimension, state.columnBoundaries);
+    if (keepSums) state.blockSums.resize(normalizationDimension * normalizationDimension);
+    vector<GridSum> sums(normalizationDimension);
+    GridSum& imageSum = state.imageSum = {0, 0, 0};
+
+    // accumulate each grid row into the sums of its block row
+    for (uint32_t row = 0; row < normalizationDimension; row++) {
+        fill(sums.begin(), sums.end(), GridSum({0, 0, 0}));
+        for (size_t i = rowBoundaries[row]; i < rowBoundaries[row + 1]; i++) {
+            const GridPixel* pixels = grid.getRow(i);
+            for (uint32_t col = 0; col < normalizationDimension; col++) {
+                uint32_t red = 0, green = 0, blue = 0;
+                for (size_t j = columnBoundaries[col]; j < columnBoundaries[col + 1]; j++) {
+                    red += pixels[j].red;
+                    green += pixels[j].green;
+                    blue += pixels[j].blue;
+                }
+                sums[col].red += red;
+                sums[col].green += green;
+                sums[col].blue += blue;
             }
         }
 
-        // update running sums
-        runningRedSum += blockSumRed;
-        runningGreenSum += blockSumGreen;
-        runningBlueSum += blockSumBlue;
-
-        // calculate block mean
-        uint32_t overflowDivisor = verticalOverflow * horizontalScaleSize;
-        normalizedGrid.setPixel({normalizationDimension, col + 1}, {uint8_t(blockSumRed / overflowDivisor), 
-            uint8_t(blockSumGreen / overflowDivisor), uint8_t(blockSumBlue / overflowDivisor)});
-    }
-
-    // build overflow row/col
-    size_t blockSumRed = 0, blockSumGreen = 0, blockSumBlue = 0;
-    for (uint32_t i = 1; i <= verticalOverflow; i++) {
-        for (uint32_t j = 1; j <= horizontalOverflow; j++) {
-            GridPixel& pixel = pixelGrid.getPixel({overflowRow + i, overflowColumn + j});
-            blockSumRed += pixel.red;
-            blockSumGreen += pixel.green;
-            blockSumBlue += pixel.blue;
+        // set block means (and keep the row's sums for updates)
+        GridPixel* pixels = state.normalizedGrid->getRow(row);
+        const size_t blockHeight = rowBoundaries[row + 1] - rowBoundaries[row];
+        for (uint32_t col = 0; col < normalizationDimension; col++) {
+            const size_t blockDivisor = blockHeight * (columnBoundaries[col + 1] - columnBoundaries[col]);
+            if (!blockDivisor) throw "ImagePerceptualHash Error: Invalid target block.";
+            pixels[col] = {uint8_t(sums[col].red / blockDivisor), uint8_t(sums[col].green / blockDivisor), 
+                uint8_t(sums[col].blue / blockDivisor)};
+            imageSum.red += sums[col].red;
+            imageSum.green += sums[col].green;
+            imageSum.blue += sums[col].blue;
         }
+        if (keepSums) copy(sums.begin(), sums.end(), &state.blockSums[row * normalizationDimension]);
     }
 
-    // wrap-up overflow normalization
-    runningRedSum += blockSumRed;
-    runningGreenSum += blockSumGreen;
-    runningBlueSum += blockSumBlue;
-    uint32_t overflowDivisor = verticalOverflow * horizontalOverflow;
-    normalizedGrid.setPixel({normalizationDimension, normalizationDimension}, {uint8_t(blockSumRed / overflowDivisor), 
-        uint8_t(blockSumGreen / overflowDivisor), uint8_t(blockSumBlue / overflowDivisor)});
-    uint32_t imageDivisor = pixelGrid.getGridHeight() * pixelGrid.getGridWidth();
-    return {uint8_t(runningRedSum / imageDivisor), uint8_t(runningGreenSum / imageDivisor), 
-        uint8_t(runningBlueSum / imageDivisor)};
+    // compute image mean
+    const size_t imageDivisor = grid.getGridHeight() * grid.getGridWidth();
+    return {uint8_t(imageSum.red / imageDivisor), uint8_t(imageSum.green / imageDivisor), 
+        uint8_t(imageSum.blue / imageDivisor)};
 }
 
 /*
- * Breaks down normalized image into hash using mean RGB key.
+ * Breaks down normalized image into hash using mean RGB key (hash rows must
+ * be zeroed), through the dimension's specialized engine when it has one.
  */
 void ImagePerceptualHash::computeRGBHash(const PixelGrid& normalizedGrid, const GridPixel& mean) {
-    const uint32_t luminance = 0.2126 * uint32_t(mean.red) + 0.7152 * uint32_t(mean.green) + 
-        0.0722 * uint32_t(mean.blue);
-    const uint8_t grayscaleMean = uint8_t((uint32_t(mean.red) + uint32_t(mean.green) + 
-        uint32_t(mean.blue)) / 3);
-    
-    // iterate through normalized grid
-    for (uint32_t i = 1; i <= normalizationDimension; i++) {
-        for (uint32_t j = 1; j <= normalizationDimension; j++) {
-            uint32_t position = (((i - 1) * normalizationDimension) + (j - 1));
-            uint32_t bucket = position / 64;
-            uint32_t iterator = position % 64;
-
-            // compute RGB hash
-            const GridPixel& pixel = normalizedGrid.getPixel({i, j});
-            if (pixel.red >= mean.red) (*(result.redData))[bucket] |= 0x1 << iterator;
-            if (pixel.green >= mean.green) (*(result.greenData))[bucket] |= 0x1 << iterator;
-            if (pixel.blue >= mean.blue) (*(result.blueData))[bucket] |= 0x1 << iterator;
-
-            // compute luminance hash
-            const uint32_t pixelLuminance = 0.2126 * uint32_t(pixel.red) + 0.7152 * uint32_t(pixel.green) + 
-                0.0722 * uint32_t(pixel.blue);
-            if (pixelLuminance >= luminance) (*(result.luminanceData))[bucket] |= 0x1 << iterator;
-
-            // compute grayscale hash
-            const uint8_t pixelMean = uint8_t((uint32_t(pixel.red) + uint32_t(pixel.green) + 
-                uint32_t(pixel.blue)) / 3);
-            if (pixelMean >= grayscaleMean) (*(result.grayscaleData))[bucket] |= 0x1 << iterator;
-
-            // compute combined hash 1
-            uint8_t majorityBool = uint8_t(pixel.red >= mean.red) + 
-                uint8_t(pixel.green >= mean.green) + uint8_t(pixel.blue >= mean.blue);
-            if ((majorityBool == 0) || (majorityBool == 2)) 
-                (*(result.combinedData1))[bucket] |= 0x1 << iterator;
-
-            // compute combined hash 2
-            if ((majorityBool == 1) || (majorityBool == 3)) 
-                (*(result.combinedData2))[bucket] |= 0x1 << iterator;
-        }
-    }    
+    computeBitplanes(normalizedGrid, normalizationDimension, mean, hashRows.get());
 } 
 
+/*
+ * Writes every channel bit of one normalized block against the mean RGB key.
+ */
+void ImagePerceptualHash::setBlockBits(const uint32_t position, const GridPixel& pixel, 
+    const GridPixel& mean, const uint32_t luminance, const uint8_t grayscaleMean) {
+    uint64_t* words = hashRows[position / 64].channelData;
+    const uint64_t bit = uint64_t(0x1) << (position % 64);
+
+    // compute RGB hash
+    words[RED_CHANNEL] = (pixel.red >= mean.red) ? (words[RED_CHANNEL] | bit) : (words[RED_CHANNEL] & ~bit);
+    words[GREEN_CHANNEL] = (pixel.green >= mean.green) ? (words[GREEN_CHANNEL] | bit) : 
+        (words[GREEN_CHANNEL] & ~bit);
+    words[BLUE_CHANNEL] = (pixel.blue >= mean.blue) ? (words[BLUE_CHANNEL] | bit) : (words[BLUE_CHANNEL] & ~bit);
+
+    // compute luminance hash
+    words[LUMINANCE_CHANNEL] = meetsLuminance(pixel, luminance) ? (words[LUMINANCE_CHANNEL] | bit) : 
+        (words[LUMINANCE_CHANNEL] & ~bit);
+
+    // compute grayscale hash (truncated channel mean against the mean's, in integers)
+    const uint32_t pixelSum = uint32_t(pixel.red) + uint32_t(pixel.green) + uint32_t(pixel.blue);
+    words[GRAYSCALE_CHANNEL] = (pixelSum >= (3 * uint32_t(grayscaleMean))) ? (words[GRAYSCALE_CHANNEL] | bit) : 
+        (words[GRAYSCALE_CHANNEL] & ~bit);
+
+    // compute combined hashes 1 (even majority) and 2 (odd majority)
+    const uint8_t majorityBool = uint8_t(pixel.red >= mean.red) + 
+        uint8_t(pixel.green >= mean.green) + uint8_t(pixel.blue >= mean.blue);
+    words[COMBINED1_CHANNEL] = !(majorityBool & 0x1) ? (words[COMBINED1_CHANNEL] | bit) : 
+        (words[COMBINED1_CHANNEL] & ~bit);
+    words[COMBINED2_CHANNEL] = (majorityBool & 0x1) ? (words[COMBINED2_CHANNEL] | bit) : 
+        (words[COMBINED2_CHANNEL] & ~bit);
+}
+
 /*
  * Frees dynamic memory.
  */
 ImagePerceptualHash::~ImagePerceptualHash(void) {
-    result.redData.reset(nullptr);
-    result.greenData.reset(nullptr);
-    result.blueData.reset(nullptr);
-    result.luminanceData.reset(nullptr);
-    result.grayscaleData.reset(nullptr);
-    result.combinedData1.reset(nullptr);
-    result.combinedData2.reset(nullptr);
+    updateState.reset(nullptr);
+    hashRows.reset();
 }
 
@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include "index/cluster.h"
+using namespace std;
+
+/*
+ * Copies the key channel of every hash into contiguous words so tiles of
+ * hashes compare from dense memory, and sizes tiles so each thread gets
+ * several tile rows.
+ */
+HashClusterer::HashClusterer(const HashRow* hashes, const size_t hashCount, const uint32_t rowCount,
+    const HashChannel keyChannel, const size_t threadCount) : hashCount(hashCount), rowCount(rowCount),
+    pool(threadCount), tileSize(CLUSTER_TILE_HASHES), comparisons(0), mergedPairs(0), stats() {
+    if (!rowCount) throw "HashClusterer Error: Invalid row count.";
+    if (hashCount >= numeric_limits<uint32_t>::max()) throw "HashClusterer Error: Too many hashes.";
+    keyWords.reset(new vector<uint64_t>(hashCount * rowCount));
+    for (size_t i = 0; i < hashCount; i++) {
+        for (uint32_t r = 0; r < rowCount; r++)
+            (*keyWords)[(i * rowCount) + r] = hashes[(i * rowCount) + r].channelData[keyChannel];
+    }
+    tileSize = min((size_t) CLUSTER_TILE_HASHES, max((size_t) CLUSTER_MIN_TILE_HASHES,
+        hashCount / (CLUSTER_TILES_PER_THREAD * pool.getThreadCount())));
+}
+
+/*
+ * Returns the root of a hash's set, halving the path on the way.
+ */
+uint32_t HashClusterer::findRoot(uint32_t hashId) {
+    while (true) {
+        uint32_t parent = parents[hashId].load(memory_order_acquire);
+        if (parent == hashId) return hashId;
+        const uint32_t grandparent = parents[parent].load(memory_order_acquire);
+        if (parent != grandparent) parents[hashId].compare_exchange_weak(parent, grandparent, memory_order_acq_rel);
+        hashId = grandparent;
+    }
+}
+
+/*
+ * Joins the sets of two hashes by linking the larger root under the smaller
+ * (retrying if another thread relinked the root first). Returns false if
+ * the hashes already share a set.
+ */
+bool HashClusterer::unite(uint32_t hashId1, uint32_t hashId2) {
+    while (true) {
+        hashId1 = findRoot(hashId1);
+        hashId2 = findRoot(hashId2);
+        if (hashId1 == hashId2) return false;
+        if (hashId1 < hashId2) swap(hashId1, hashId2);
+        uint32_t expected = hashId1;
+        if (parents[hashId1].compare_exchange_strong(expected, hashId2, memory_order_acq_rel)) return true;
+    }
+}
+
+/*
+ * Compares every hash of one tile with every hash of another (each pair
+ * once within a tile) and merges pairs within distance.
+ */
+void HashClusterer::compareTiles(const size_t tile1, const size_t tile2, const uint32_t distance) {
+    const uint64_t* words = keyWords->data();
+    const size_t end1 = min((tile1 + 1) * tileSize, hashCount), end2 = min((tile2 + 1) * tileSize, hashCount);
+    uint64_t tileComparisons = 0, tileMerges = 0;
+    for (size_t i = tile1 * tileSize; i < end1; i++) {
+        const size_t start2 = (tile1 == tile2) ? (i + 1) : (tile2 * tileSize);
+        for (size_t j = start2; j < end2; j++) {
+            if ((computeHammingDistance(words + (i * rowCount), words + (j * rowCount), rowCount) <= distance) &&
+                unite(i, j)) tileMerges++;
+        }
+        tileComparisons += (end2 > start2) ? (end2 - start2) : 0;
+    }
+    comparisons += tileComparisons;
+    mergedPairs += tileMerges;
+}
+
+/*
+ * Groups every pair of hashes within distance on the key channel into
+ * clusters (transitively). Tile rows are paired first-with-last so every
+ * task compares the same number of tiles; cluster ids are dense and
+ * numbered in order of each cluster's first hash.
+ */
+void HashClusterer::cluster(const uint32_t distance) {
+    const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    parents.reset(new atomic<uint32_t>[max(hashCount, (size_t) 1)]);
+    for (size_t i = 0; i < hashCount; i++) parents[i].store(i, memory_order_relaxed);
+    comparisons = 0;
+    mergedPairs = 0;
+
+    // compare tile rows i and (tileCount - 1 - i) against every later tile
+    const size_t tileCount = (hashCount + tileSize - 1) / tileSize;
+    for (size_t i = 0; i < ((tileCount + 1) / 2); i++) {
+        pool.submit([this, i, tileCount, distance] {
+            const size_t mirror = tileCount - 1 - i;
+            for (size_t j = i; j < tileCount; j++) compareTiles(i, j, distance);
+            if (mirror != i) for (size_t j = mirror; j < tileCount; j++) compareTiles(mirror, j, distance);
+        });
+    }
+    pool.wait();
+    if (pool.getFailureCount()) throw "HashClusterer Error: Tile comparison failed.";
+
+    // number clusters by first member
+    clusterIds.assign(hashCount, 0);
+    vector<uint32_t> rootIds(hashCount, numeric_limits<uint32_t>::max());
+    size_t clusterCount = 0;
+    for (size_t i = 0; i < hashCount; i++) {
+        const uint32_t root = findRoot(i);
+        if (rootIds[root] == numeric_limits<uint32_t>::max()) rootIds[root] = clusterCount++;
+        clusterIds[i] = rootIds[root];
+    }
+    stats = {hashCount, clusterCount, comparisons, mergedPairs, (uint64_t) chrono::duration_cast<
+        chrono::nanoseconds>(chrono::steady_clock::now() - start).count()};
+}
+
+/*
+ * Frees key words and the union-find forest.
+ */
+HashClusterer::~HashClusterer(void) {
+    keyWords.reset(nullptr);
+    parents.reset(nullptr);
+}
@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <queue>
+#include <unordered_set>
+#include "index/hindex.h"
+using namespace std;
+
+/*
+ * Enumerates every key at exactly the supplied Hamming distance from key 
+ * within the low keyBits bits.
+ */
+static void forEachNeighbor(const uint32_t key, const uint32_t keyBits, const uint32_t distance, 
+    const function<void(uint32_t)>& visit) {
+    if (distance > keyBits) return;
+    vector<uint32_t> flips(distance);
+    for (uint32_t i = 0; i < distance; i++) flips[i] = i;
+    while (true) {
+        uint32_t neighbor = key;
+        for (const uint32_t bit : flips) neighbor ^= uint32_t(0x1) << bit;
+        visit(neighbor);
+
+        // advance to next bit combination
+        int32_t i = int32_t(distance) - 1;
+        while ((i >= 0) && (flips[i] == (keyBits - distance + i))) i--;
+        if (i < 0) return;
+        flips[i]++;
+        for (uint32_t j = i + 1; j < distance; j++) flips[j] = flips[j - 1] + 1;
+    }
+}
+
+/*
+ * Orders matches by key distance, then by id.
+ */
+static bool compareMatches(const HammingMatch& m1, const HammingMatch& m2) {
+    return (m1.distance < m2.distance) || ((m1.distance == m2.distance) && (m1.hashId < m2.hashId));
+}
+
+/*
+ * Copies key channel words of a hash.
+ */
+static void copyKeyWords(const HashRow* hash, const uint32_t rowCount, const HashChannel keyChannel, 
+    uint64_t* words) {
+    for (uint32_t r = 0; r < rowCount; r++) words[r] = hash[r].channelData[keyChannel];
+}
+
+/*
+ * Initializes empty multi-index over the key channel of hashes with the 
+ * supplied row count. The key is split into substrings of substringBits.
+ */
+HammingIndex::HammingIndex(const uint32_t rowCount, const HashChannel keyChannel, 
+    const uint32_t substringBits) : hashCount(0), indexedCount(0), rowCount(rowCount), keyChannel(keyChannel), 
+    substringBits(substringBits), substringCount((rowCount * HASH_SEGMENT_SIZE) / substringBits) {
+    if ((substringBits != 8) && (substringBits != 16) && (substringBits != 32))
+        throw "HammingIndex Error: Substring size must be 8, 16 or 32 bits.";
+    if (!rowCount) throw "HammingIndex Error: Invalid hash row count.";
+    keyWords.reset(new vector<uint64_t>());
+    indexPostings();
+}
+
+/*
+ * Extracts key substring (substrings never straddle a 64-bit word).
+ */
+uint32_t HammingIndex::getSubstring(const uint64_t* words, const uint32_t substring) const {
+    const uint32_t bitOffset = substring * substringBits;
+    const uint64_t mask = (uint64_t(0x1) << substringBits) - 1;
+    return uint32_t((words[bitOffset / HASH_SEGMENT_SIZE] >> (bitOffset % HASH_SEGMENT_SIZE)) & mask);
+}
+
+/*
+ * Rebuilds every substring table as flat postings sorted by key and id over
+ * all stored hashes.
+ */
+void HammingIndex::indexPostings(void) {
+    substringTables.reset(new vector<SubstringPostings>(substringCount));
+    vector<uint64_t> postings(hashCount);
+    for (uint32_t s = 0; s < substringCount; s++) {
+        for (size_t id = 0; id < hashCount; id++) 
+            postings[id] = (uint64_t(getSubstring(getKeyWords(id), s)) << 32) | id;
+        sort(postings.begin(), postings.end());
+
+        // split sorted postings into ids and keys (or key offsets)
+        SubstringPostings& table = (*substringTables)[s];
+        const bool directFlag = substringBits <= DIRECT_SUBSTRING_BITS;
+        table.ids.resize(hashCount);
+        if (directFlag) table.offsets.assign((size_t(0x1) << substringBits) + 1, 0);
+        else table.keys.resize(hashCount);
+        for (size_t i = 0; i < hashCount; i++) {
+            table.ids[i] = uint32_t(postings[i]);
+            if (directFlag) table.offsets[(postings[i] >> 32) + 1]++;
+            else table.keys[i] = uint32_t(postings[i] >> 32);
+        }
+        for (size_t k = 1; k < table.offsets.size(); k++) table.offsets[k] += table.offsets[k - 1];
+    }
+    indexedCount = hashCount;
+}
+
+/*
+ * Replaces index contents with supplied contiguous hashes.
+ */
+void HammingIndex::build(const HashRow* hashArray, const size_t count) {
+    if (count >= UINT32_MAX) throw "HammingIndex Error: Too many hashes.";
+    keyWords.reset(new vector<uint64_t>(count * rowCount));
+    for (size_t id = 0; id < count; id++) 
+        copyKeyWords(hashArray + (id * rowCount), rowCount, keyChannel, &(*keyWords)[id * rowCount]);
+    hashCount = count;
+    indexPostings();
+}
+
+/*
+ * Appends one hash to the index and returns its id. New hashes are scanned
+ * linearly until enough accumulate to rebuild the postings.
+ */
+uint32_t HammingIndex::insert(const HashRow* hash) {
+    if (hashCount >= (UINT32_MAX - 1)) throw "HammingIndex Error: Too many hashes.";
+    const uint32_t id = hashCount++;
+    (*keyWords).resize(hashCount * rowCount);
+    copyKeyWords(hash, rowCount, keyChannel, &(*keyWords)[id * rowCount]);
+    if ((hashCount - indexedCount) > max((size_t) MIN_PENDING_HASHES, indexedCount / 4)) indexPostings();
+    return id;
+}
+
+/*
+ * Returns number of table lookups needed to probe every key at exactly
+ * substringDistance (saturating).
+ */
+uint64_t HammingIndex::countProbes(const uint32_t substringDistance) const {
+    uint64_t combinations = 1;
+    for (uint32_t i = 0; i < substringDistance; i++) {
+        combinations = (combinations * (substringBits - i)) / (i + 1);
+        if (combinations > (UINT64_MAX / (substringBits * substringCount))) return UINT64_MAX;
+    }
+    return combinations * substringCount;
+}
+
+/*
+ * Visits ids whose key substrings are at exactly substringDistance from the 
+ * query's in at least one substring table.
+ */
+void HammingIndex::probeSubstrings(const uint64_t* query, const uint32_t substringDistance, 
+    const function<void(uint32_t)>& visit) const {
+    for (uint32_t s = 0; s < substringCount; s++) {
+        const SubstringPostings& table = (*substringTables)[s];
+        forEachNeighbor(getSubstring(query, s), substringBits, substringDistance, [&](uint32_t key) {
+            size_t begin, end;
+            if (substringBits <= DIRECT_SUBSTRING_BITS) {
+                begin = table.offsets[key];
+                end = table.offsets[key + 1];
+            }
+            else {
+                const auto range = equal_range(table.keys.begin(), table.keys.end(), key);
+                begin = range.first - table.keys.begin();
+                end = range.second - table.keys.begin();
+            }
+            for (size_t i = begin; i < end; i++) visit(table.ids[i]);
+        });
+    }
+}
+
+/*
+ * Finds every stored hash within radius of the query on the key channel. By
+ * pigeonhole, each such hash matches some substring within radius / count.
+ * Radii needing more probes than there are indexed hashes scan instead.
+ */
+void HammingIndex::radiusQuery(const HashRow* query, const uint32_t radius, 
+    vector<HammingMatch>& matches) const {
+    matches.clear();
+    vector<uint64_t> queryWords(rowCount);
+    copyKeyWords(query, rowCount, keyChannel, queryWords.data());
+    const auto consider = [&](const uint32_t id) {
+        const uint32_t distance = computeHammingDistance(queryWords.data(), getKeyWords(id), rowCount);
+        if (distance <= radius) matches.push_back({id, distance});
+    };
+
+    // probe substring tables (or scan every indexed hash past the probe budget)
+    const uint32_t maxSubstringDistance = min(radius / substringCount, substringBits);
+    uint64_t probeCount = 0;
+    bool scanFlag = false;
+    for (uint32_t d = 0; (d <= maxSubstringDistance) && !scanFlag; d++) {
+        const uint64_t probes = countProbes(d);
+        scanFlag = probes > (indexedCount - probeCount);
+        probeCount += scanFlag ? 0 : probes;
+    }
+    if (scanFlag) for (size_t id = 0; id < indexedCount; id++) consider(id);
+    else {
+        unordered_set<uint32_t> visited;
+        for (uint32_t d = 0; d <= maxSubstringDistance; d++) {
+            probeSubstrings(queryWords.data(), d, [&](uint32_t id) { 
+                if (visited.insert(id).second) consider(id); });
+        }
+    }
+
+    // scan hashes inserted since the last rebuild
+    for (size_t id = indexedCount; id < hashCount; id++) consider(id);
+    sort(matches.begin(), matches.end(), compareMatches);
+}
+
+/*
+ * Finds the k nearest stored hashes on the key channel by widening the 
+ * substring search until no unseen hash can beat the current k-th match.
+ * Once the next distance would probe more keys than there are indexed
+ * hashes, the remaining hashes are scanned instead.
+ */
+void HammingIndex::nearestQuery(const HashRow* query, const size_t k, 
+    vector<HammingMatch>& matches) const {
+    matches.clear();
+    if (!k) return;
+    vector<uint64_t> queryWords(rowCount);
+    copyKeyWords(query, rowCount, keyChannel, queryWords.data());
+    priority_queue<HammingMatch, vector<HammingMatch>, decltype(&compareMatches)> best(compareMatches);
+    const auto consider = [&](const uint32_t id) {
+        const HammingMatch match = {id, computeHammingDistance(queryWords.data(), getKeyWords(id), rowCount)};
+        if (best.size() < k) best.push(match);
+        else if (compareMatches(match, best.top())) {
+            best.pop();
+            best.push(match);
+        }
+    };
+
+    // scan hashes inserted since the last rebuild, then widen substring probes
+    for (size_t id = indexedCount; id < hashCount; id++) consider(id);
+    unordered_set<uint32_t> visited;
+    uint64_t probeCount = 0;
+    for (uint32_t d = 0; d <= substringBits; d++) {
+
+        // unseen hashes differ by at least d in every substring
+        if ((best.size() == min(k, hashCount)) && 
+            ((best.empty()) || (best.top().distance < (d * substringCount)))) break;
+        const uint64_t probes = countProbes(d);
+        if (probes > (indexedCount - probeCount)) {
+            for (size_t id = 0; id < indexedCount; id++) if (!visited.count(id)) consider(id);
+            break;
+        }
+        probeCount += probes;
+        probeSubstrings(queryWords.data(), d, [&](uint32_t id) { if (visited.insert(id).second) consider(id); });
+    }
+
+    // return in ascending distance
+    while (!best.empty()) {
+        matches.push_back(best.top());
+        best.pop();
+    }
+    reverse(matches.begin(), matches.end());
+}
+
+/*
+ * Frees dynamic memory.
+ */
+HammingIndex::~HammingIndex(void) {
+    substringTables.reset(nullptr);
+    keyWords.reset(nullptr);
+}
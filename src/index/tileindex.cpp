@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include "pimg/integral.h"
+#include "index/tileindex.h"
+using namespace std;
+
+// (image, level shift, offset bins) vote accumulator
+typedef struct {
+    uint32_t votes;
+    int64_t rowOffsetSum;
+    int64_t columnOffsetSum;
+} TileVote;
+
+/*
+ * Initializes empty tile pyramid index. Each image stores levelCount levels
+ * of tileSize windows, starting at the first power-of-two reduction whose
+ * longest side fits maxLevelDimension.
+ */
+TileIndex::TileIndex(const uint32_t tileSize, const uint32_t levelCount,
+    const uint32_t maxLevelDimension) : imageCount(0), tileSize(tileSize), levelCount(levelCount),
+    maxLevelDimension(maxLevelDimension) {
+    if (tileSize < TOKEN_REDUCTION_DIMENSION) throw "TileIndex Error: Tile smaller than token reduction.";
+    if (!levelCount || (maxLevelDimension < tileSize)) throw "TileIndex Error: Invalid pyramid parameters.";
+    tileHashes.reset(new HammingIndex(1, LUMINANCE_CHANNEL, 16));
+    tileEntries.reset(new vector<TileEntry>());
+}
+
+/*
+ * Returns first pyramid level whose longest side fits the maximum dimension.
+ */
+uint32_t TileIndex::getFirstLevel(const PixelGrid& grid) const {
+    uint32_t level = 0;
+    while ((max(grid.getGridHeight(), grid.getGridWidth()) >> level) > maxLevelDimension) level++;
+    return level;
+}
+
+/*
+ * Hashes every tile of each power-of-two reduction in [firstLevel, lastLevel]
+ * that still holds a full tile. Reductions are block means of one shared
+ * integral grid. A nonzero tile budget widens the stride so that no level
+ * hashes more than its share of the budget.
+ */
+void TileIndex::hashLevels(const PixelGrid& grid, const uint32_t firstLevel, const uint32_t lastLevel,
+    const uint32_t stride, const size_t tileBudget, vector<LevelTiles>& levels) const {
+    levels.clear();
+    unique_ptr<IntegralGrid> integralGrid;
+    for (uint32_t level = firstLevel; level <= lastLevel; level++) {
+        const size_t height = grid.getGridHeight() >> level, width = grid.getGridWidth() >> level;
+        if ((height < tileSize) || (width < tileSize)) break;
+
+        // reduce grid by 2^level
+        unique_ptr<PixelGrid> reducedGrid;
+        if (level) {
+            if (integralGrid == nullptr) integralGrid.reset(new IntegralGrid(grid));
+            const size_t blockSize = size_t(0x1) << level;
+            reducedGrid.reset(new PixelGrid({height, width}));
+            for (size_t i = 0; i < height; i++) {
+                GridPixel* pixels = reducedGrid->getRow(i);
+                for (size_t j = 0; j < width; j++)
+                    pixels[j] = integralGrid->getBlockMean(i * blockSize, j * blockSize, blockSize, blockSize);
+            }
+        }
+
+        // hash every window (stride grows to respect the per-level budget)
+        size_t levelStride = stride;
+        if (tileBudget) {
+            const size_t levelBudget = max(tileBudget / (lastLevel - firstLevel + 1), (size_t) 1);
+            while ((((height - tileSize) / levelStride + 1) * ((width - tileSize) / levelStride + 1)) >
+                levelBudget) levelStride++;
+        }
+        TokenPerceptualHash regionHash(level ? *reducedGrid : grid, {tileSize, tileSize},
+            {levelStride, levelStride});
+        regionHash.executeHash();
+        levels.push_back({level, regionHash.getRegionHashes()});
+    }
+}
+
+/*
+ * Stores tile hashes of every pyramid level of the image and returns its id.
+ * Flat tiles (zero hash) carry no structure and are skipped.
+ */
+uint32_t TileIndex::insert(const PixelGrid& grid) {
+    const uint32_t imageId = imageCount;
+    const uint32_t firstLevel = getFirstLevel(grid);
+    vector<LevelTiles> levels;
+    hashLevels(grid, firstLevel, firstLevel + levelCount - 1, tileSize / 2, 0, levels);
+    if (levels.empty()) throw "TileIndex Error: Image smaller than tile size.";
+
+    // append tiles
+    HashRow row = {};
+    for (const LevelTiles& levelTiles : levels) {
+        for (const TokenRegionHash& tile : levelTiles.hashes) {
+            if (!tile.data) continue;
+            row.channelData[LUMINANCE_CHANNEL] = tile.data;
+            tileHashes->insert(&row);
+            (*tileEntries).push_back({imageId, levelTiles.level, tile.row, tile.column});
+        }
+    }
+    imageCount++;
+    return imageId;
+}
+
+/*
+ * Hashes dense query tiles at every level, votes for (image, scale, offset)
+ * across matching stored tiles and returns the best placement per image.
+ * Query work is capped at MAX_QUERY_TILES windows and MAX_TILE_CANDIDATES
+ * matches per window, so latency stays bounded as the corpus grows.
+ */
+void TileIndex::query(const PixelGrid& grid, vector<TileMatch>& matches, const size_t maxResults,
+    const uint32_t radius) const {
+    matches.clear();
+    vector<LevelTiles> levels;
+    uint32_t lastLevel = 0;
+    while ((min(grid.getGridHeight(), grid.getGridWidth()) >> (lastLevel + 1)) >= tileSize) lastLevel++;
+    hashLevels(grid, 0, lastLevel, 1, MAX_QUERY_TILES, levels);
+
+    // vote for placements of matching stored tiles
+    map<tuple<uint32_t, int32_t, int64_t, int64_t>, TileVote> votes;
+    const int64_t binSize = tileSize / 4;
+    vector<HammingMatch> candidates;
+    HashRow row = {};
+    for (const LevelTiles& levelTiles : levels) {
+        for (const TokenRegionHash& tile : levelTiles.hashes) {
+            if (!tile.data) continue;
+            row.channelData[LUMINANCE_CHANNEL] = tile.data;
+            tileHashes->radiusQuery(&row, radius, candidates);
+            if (candidates.size() > MAX_TILE_CANDIDATES) continue;
+            for (const HammingMatch& candidate : candidates) {
+                const TileEntry& entry = (*tileEntries)[candidate.hashId];
+                const int64_t rowOffset = (int64_t(entry.row) - tile.row) << entry.level;
+                const int64_t columnOffset = (int64_t(entry.column) - tile.column) << entry.level;
+                const int64_t levelBin = binSize << entry.level;
+                TileVote& vote = votes[make_tuple(entry.imageId, int32_t(entry.level) - int32_t(levelTiles.level),
+                    (rowOffset >= 0 ? rowOffset : rowOffset - levelBin + 1) / levelBin,
+                    (columnOffset >= 0 ? columnOffset : columnOffset - levelBin + 1) / levelBin)];
+                vote.votes++;
+                vote.rowOffsetSum += rowOffset;
+                vote.columnOffsetSum += columnOffset;
+            }
+        }
+    }
+
+    // keep best placement per image
+    map<uint32_t, TileMatch> best;
+    for (const auto& vote : votes) {
+        const uint32_t imageId = get<0>(vote.first);
+        const int32_t levelShift = get<1>(vote.first);
+        const TileVote& tally = vote.second;
+        if (tally.votes < MIN_TILE_VOTES) continue;
+        auto current = best.find(imageId);
+        if ((current != best.end()) && (current->second.votes >= tally.votes)) continue;
+        best[imageId] = {imageId, tally.rowOffsetSum / tally.votes, tally.columnOffsetSum / tally.votes,
+            levelShift >= 0 ? float(uint32_t(0x1) << levelShift) : 1.0f / float(uint32_t(0x1) << -levelShift),
+            tally.votes};
+    }
+    for (const auto& match : best) matches.push_back(match.second);
+    sort(matches.begin(), matches.end(), [](const TileMatch& m1, const TileMatch& m2) {
+        return (m1.votes > m2.votes) || ((m1.votes == m2.votes) && (m1.imageId < m2.imageId)); });
+    if (matches.size() > maxResults) matches.resize(maxResults);
+}
+
+/*
+ * Frees dynamic memory.
+ */
+TileIndex::~TileIndex(void) {
+    tileEntries.reset(nullptr);
+    tileHashes.reset(nullptr);
+}
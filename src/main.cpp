@@ -1,12 +1,348 @@
 #include <iostream>
 #include <string>
+#include <vector>
 #include <cstdio>
+#include <cstdlib>
 #include <ctime>
+#include <memory>
+#include <fstream>
+#include <unistd.h>
 #include "hash/phash.h"
 #include "pimg/pimage.h"
+#include "store/hashdb.h"
+#include "exec/batch.h"
+#include "index/tileindex.h"
+#include "index/cluster.h"
+#include "exec/daemon.h"
+#include "exec/video.h"
 using namespace std;
 
+/*
+ * Parses comma-separated list of normalization sizes.
+ */
+static vector<uint32_t> parseSizes(const string& list) {
+    vector<uint32_t> sizes;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == string::npos) end = list.size();
+        const int size = atoi(list.substr(start, end - start).c_str());
+        if (size <= 0) throw "Usage Error: Invalid normalization size.";
+        sizes.push_back(size);
+        start = end + 1;
+    }
+    return sizes;
+}
+
+/*
+ * Batch mode: pure-image --batch <directory|list-file> [--threads N] [--sizes 16,32,64]
+ * [--database file] [--metrics file] [--metrics-per-image file] [--cache file] [--fast-decode] [--stream]
+ */
+static int runBatch(int args, char* argv[]) {
+    size_t threadCount = 0;
+    vector<uint32_t> sizes = {DEFAULT_NORMALIZATION_DIMENSION};
+    string databasePath, metricsPath, imageMetricsPath, cachePath;
+    bool fastDecode = false, streamLoad = false;
+    for (int i = 3; i < args; i++) {
+        const string option = argv[i];
+        if (option == "--fast-decode") { fastDecode = true; continue; }
+        if (option == "--stream") { streamLoad = true; continue; }
+        if ((i + 1) >= args) throw "Usage Error: Missing batch option value.";
+        if (option == "--threads") threadCount = atoi(argv[++i]);
+        else if (option == "--sizes") sizes = parseSizes(argv[++i]);
+        else if (option == "--database") databasePath = argv[++i];
+        else if (option == "--metrics") metricsPath = argv[++i];
+        else if (option == "--metrics-per-image") imageMetricsPath = argv[++i];
+        else if (option == "--cache") cachePath = argv[++i];
+        else throw "Usage Error: Unknown batch option.";
+    }
+
+    // open (or create) database at the first batch size
+    unique_ptr<HashDatabase> database;
+    if (!databasePath.empty()) {
+        if (access(databasePath.c_str(), F_OK)) HashDatabase::create(databasePath, sizes.front());
+        database.reset(new HashDatabase(databasePath, true));
+    }
+    unique_ptr<ResultCache> cache;
+    if (!cachePath.empty()) cache.reset(new ResultCache(cachePath));
+    ofstream imageMetricsFile;
+    if (!imageMetricsPath.empty()) {
+        imageMetricsFile.open(imageMetricsPath);
+        if (!imageMetricsFile.is_open()) throw "Usage Error: Failed to open per-image metrics file.";
+    }
+
+    // hash every collected file
+    vector<string> filenames;
+    BatchHasher::collectFilenames(argv[2], filenames);
+    BatchHasher hasher(cout, threadCount, sizes);
+    MetricsHistogram metrics;
+    hasher.setDatabase(database.get());
+    hasher.setMetrics(&metrics);
+    if (imageMetricsFile.is_open()) hasher.setImageMetrics(&imageMetricsFile);
+    hasher.setFastDecode(fastDecode);
+    hasher.setStreamLoad(streamLoad);
+    hasher.setCache(cache.get());
+    hasher.hashFiles(filenames);
+    if (!metricsPath.empty()) {
+        ofstream metricsFile(metricsPath);
+        if (!metricsFile.is_open()) throw "Usage Error: Failed to open metrics file.";
+        metrics.writeJSON(metricsFile);
+    }
+    const PoolStats poolStats = hasher.getPoolStats();
+    cerr << "Hashed " << hasher.getHashedCount() << " of " << filenames.size() << " images (" << 
+        poolStats.hitCount << " of " << (poolStats.hitCount + poolStats.missCount) << 
+        " buffers recycled)." << endl;
+    if (cache) {
+        const CacheStats cacheStats = cache->getStats();
+        cerr << "Cache served " << (cacheStats.identityHits + cacheStats.digestHits) << " images (" <<
+            cacheStats.digestHits << " by content digest), " << cacheStats.misses << " misses, " <<
+            cacheStats.storedEntries << " entries stored." << endl;
+    }
+    return hasher.getFailureCount() ? 1 : 0;
+}
+
+/*
+ * Fast decode verification: pure-image --verify-decode <directory|list-file> [--size N]
+ * [--threshold ratio]
+ */
+static int runVerifyDecode(int args, char* argv[]) {
+    uint32_t size = DEFAULT_NORMALIZATION_DIMENSION;
+    float threshold = FAST_DECODE_DRIFT_THRESHOLD;
+    for (int i = 3; i < args; i++) {
+        const string option = argv[i];
+        if ((i + 1) >= args) throw "Usage Error: Missing verify option value.";
+        if (option == "--size") size = parseSizes(argv[++i]).front();
+        else if (option == "--threshold") threshold = atof(argv[++i]);
+        else throw "Usage Error: Unknown verify option.";
+    }
+
+    // report hash drift of every file against full decode
+    vector<string> filenames;
+    BatchHasher::collectFilenames(argv[2], filenames);
+    size_t exceededCount = 0;
+    for (const string& filename : filenames) {
+        try {
+            const float drift = PureImage::measureFastDecodeDrift(filename, size);
+            if (drift > threshold) exceededCount++;
+            cout << filename << "\t" << to_string(drift) << ((drift > threshold) ? "\tEXCEEDED" : "") << endl;
+        }
+        catch (const char* e) { cerr << filename << "\t" << e << endl; }
+    }
+    cerr << exceededCount << " of " << filenames.size() << " images exceeded drift threshold." << endl;
+    return exceededCount ? 1 : 0;
+}
+
+/*
+ * Video mode: pure-image --video <video> [--size N] [--dedupe ratio] [--shot ratio] [--stride N]
+ */
+static int runVideo(int args, char* argv[]) {
+    uint32_t size = DEFAULT_NORMALIZATION_DIMENSION, stride = 1;
+    float dedupeThreshold = DEFAULT_FRAME_DEDUPE_THRESHOLD, shotThreshold = DEFAULT_SHOT_CUT_THRESHOLD;
+    for (int i = 3; i < args; i++) {
+        const string option = argv[i];
+        if ((i + 1) >= args) throw "Usage Error: Missing video option value.";
+        if (option == "--size") size = parseSizes(argv[++i]).front();
+        else if (option == "--dedupe") dedupeThreshold = atof(argv[++i]);
+        else if (option == "--shot") shotThreshold = atof(argv[++i]);
+        else if (option == "--stride") stride = atoi(argv[++i]);
+        else throw "Usage Error: Unknown video option.";
+    }
+
+    // hash frames and print per-shot keyframe sequences
+    VideoHasher video(argv[2], size, dedupeThreshold, shotThreshold, stride);
+    video.executeHash();
+    video.writeShots(cout);
+    const VideoStats& stats = video.getStats();
+    const double seconds = max(stats.totalTime, (uint64_t) 1) / 1e9;
+    cerr << "Kept " << stats.keyframeCount << " of " << stats.hashedFrames << " frames in " << 
+        video.getShots().size() << " shots (" << to_string(stats.hashedFrames / seconds) << " frames/s, decode " << 
+        to_string(stats.decodeTime / 1e9) << "s, hash " << to_string(stats.hashTime / 1e9) << "s)." << endl;
+    return 0;
+}
+
+/*
+ * Crop search: pure-image --crop-search <query-image> <directory|list-file> [--results N]
+ */
+static int runCropSearch(int args, char* argv[]) {
+    size_t maxResults = 1;
+    for (int i = 4; i < args; i++) {
+        const string option = argv[i];
+        if ((i + 1) >= args) throw "Usage Error: Missing crop search option value.";
+        if (option == "--results") maxResults = atoi(argv[++i]);
+        else throw "Usage Error: Unknown crop search option.";
+    }
+
+    // index tile pyramid of every image
+    vector<string> filenames;
+    BatchHasher::collectFilenames(argv[3], filenames);
+    TileIndex tileIndex;
+    vector<string> indexedFilenames;
+    for (const string& filename : filenames) {
+        try {
+            BMPImage image(filename);
+            image.loadBMPImage();
+            tileIndex.insert(image.getBMPPixelGrid());
+            indexedFilenames.push_back(filename);
+        }
+        catch (const char* e) { cerr << filename << "\t" << e << endl; }
+    }
+
+    // report best source placements of the query
+    BMPImage queryImage(argv[2]);
+    queryImage.loadBMPImage();
+    vector<TileMatch> matches;
+    tileIndex.query(queryImage.getBMPPixelGrid(), matches, maxResults);
+    for (const TileMatch& match : matches) {
+        cout << indexedFilenames[match.imageId] << "\t" << match.rowOffset << "\t" << match.columnOffset 
+            << "\t" << to_string(match.scale) << "\t" << match.votes << endl;
+    }
+    return matches.empty() ? 1 : 0;
+}
+
+/*
+ * Cluster mode: pure-image --cluster <database> [--distance bits] [--threads N]
+ */
+static int runCluster(int args, char* argv[]) {
+    HashDatabase database(argv[2]);
+    if (!(database.getChannelMask() & (0x1 << LUMINANCE_CHANNEL))) 
+        throw "Usage Error: Database does not store luminance hashes.";
+    uint32_t distance = DEFAULT_MATCH_THRESHOLD * database.getRowCount() * HASH_SEGMENT_SIZE;
+    size_t threadCount = 0;
+    for (int i = 3; i < args; i++) {
+        const string option = argv[i];
+        if ((i + 1) >= args) throw "Usage Error: Missing cluster option value.";
+        if (option == "--distance") distance = atoi(argv[++i]);
+        else if (option == "--threads") threadCount = atoi(argv[++i]);
+        else throw "Usage Error: Unknown cluster option.";
+    }
+
+    // cluster stored hashes on luminance and print each image's cluster
+    HashClusterer clusterer(database.getRecords(), database.getRecordCount(), database.getRowCount(), 
+        LUMINANCE_CHANNEL, threadCount);
+    clusterer.cluster(distance);
+    const vector<uint32_t>& clusterIds = clusterer.getClusterIds();
+    for (size_t i = 0; i < clusterIds.size(); i++) cout << database.getImagePath(i) << "\t" << clusterIds[i] << "\n";
+    const ClusterStats& stats = clusterer.getStats();
+    cerr << "Grouped " << stats.hashCount << " hashes into " << stats.clusterCount << " clusters (" << 
+        stats.comparisons << " comparisons, " << to_string(stats.totalTime / 1e9) << "s)." << endl;
+    return 0;
+}
+
+/*
+ * Daemon mode: pure-image --daemon <socket> [--threads N] [--sizes 16,32,64] [--queue-depth N]
+ * [--batch-size N] [--max-connections N] [--cache file]
+ */
+static int runDaemon(int args, char* argv[]) {
+    size_t threadCount = 0, queueDepth = DEFAULT_QUEUE_DEPTH, batchSize = DEFAULT_BATCH_SIZE, 
+        maxConnections = DEFAULT_MAX_CONNECTIONS;
+    vector<uint32_t> sizes = {DEFAULT_NORMALIZATION_DIMENSION};
+    string cachePath;
+    for (int i = 3; i < args; i++) {
+        const string option = argv[i];
+        if ((i + 1) >= args) throw "Usage Error: Missing daemon option value.";
+        if (option == "--threads") threadCount = atoi(argv[++i]);
+        else if (option == "--sizes") sizes = parseSizes(argv[++i]);
+        else if (option == "--queue-depth") queueDepth = atoi(argv[++i]);
+        else if (option == "--batch-size") batchSize = atoi(argv[++i]);
+        else if (option == "--max-connections") maxConnections = atoi(argv[++i]);
+        else if (option == "--cache") cachePath = argv[++i];
+        else throw "Usage Error: Unknown daemon option.";
+    }
+    unique_ptr<ResultCache> cache;
+    if (!cachePath.empty()) cache.reset(new ResultCache(cachePath));
+    HashDaemon daemon(argv[2], threadCount, sizes, queueDepth, batchSize, maxConnections);
+    daemon.setCache(cache.get());
+    cerr << "Listening on " << argv[2] << "." << endl;
+    daemon.run();
+    return 0;
+}
+
+/*
+ * Cached image mode: pure-image <image> --cache <file> [--sizes 16,32,64]
+ */
+static int runCachedImage(int args, char* argv[]) {
+    vector<uint32_t> sizes = {DEFAULT_NORMALIZATION_DIMENSION};
+    string cachePath;
+    for (int i = 2; i < args; i++) {
+        const string option = argv[i];
+        if ((i + 1) >= args) throw "Usage Error: Missing image option value.";
+        if (option == "--cache") cachePath = argv[++i];
+        else if (option == "--sizes") sizes = parseSizes(argv[++i]);
+        else throw "Usage Error: Unknown image option.";
+    }
+
+    // serve unchanged files from the cache, otherwise hash and store
+    const string filename = argv[1];
+    ResultCache cache(cachePath);
+    vector<HashRow> rows;
+    CacheFileKey key;
+    if (!cache.lookup(filename, sizes, rows, key)) {
+        PureImage image(filename, false, sizes);
+        rows.clear();
+        for (const uint32_t normalizationSize : sizes) {
+            const ImagePerceptualHash& hash = image.getPHash(normalizationSize);
+            cache.store(key, normalizationSize, hash.getHashRows());
+            rows.insert(rows.end(), hash.getHashRows(), hash.getHashRows() + hash.getHashRowCount());
+        }
+    }
+    size_t offset = 0;
+    for (const uint32_t normalizationSize : sizes) {
+        cout << BatchHasher::formatHashRecord(filename, normalizationSize, &rows[offset]);
+        offset += (normalizationSize * normalizationSize) / HASH_SEGMENT_SIZE;
+    }
+    return 0;
+}
+
+/*
+ * Client mode: pure-image --client <socket> hash <path> | hash-bytes <file> | 
+ * compare <path> <path> | match <path> <path> [threshold] | stats | shutdown
+ */
+static int runClient(int args, char* argv[]) {
+    const string command = argv[3];
+    string request;
+    vector<uint8_t> payload;
+    if ((command == "hash") && (args == 5)) request = string("HASH\t") + argv[4];
+    else if ((command == "compare") && (args == 6)) request = string("COMPARE\t") + argv[4] + "\t" + argv[5];
+    else if ((command == "match") && ((args == 6) || (args == 7))) 
+        request = string("MATCH\t") + argv[4] + "\t" + argv[5] + ((args == 7) ? string("\t") + argv[6] : "");
+    else if ((command == "stats") && (args == 4)) request = "STATS";
+    else if ((command == "shutdown") && (args == 4)) request = "SHUTDOWN";
+    else if ((command == "hash-bytes") && (args == 5)) {
+        FILE* imageFile = fopen(argv[4], "rb");
+        if (imageFile == nullptr) throw "Usage Error: Failed to open image file.";
+        uint8_t chunk[65536];
+        size_t count;
+        while ((count = fread(chunk, 1, sizeof(chunk), imageFile)) > 0) 
+            payload.insert(payload.end(), chunk, chunk + count);
+        fclose(imageFile);
+        request = string("HASHBYTES\t") + argv[4] + "\t" + to_string(payload.size());
+    }
+    else throw "Usage Error: Unknown client request.";
+
+    // print response body (status on stderr for errors)
+    const string response = HashDaemon::sendRequest(argv[2], request, payload);
+    if (response.compare(0, 3, "OK\t") != 0) {
+        cerr << response.substr(response.find('\t') + 1);
+        return 1;
+    }
+    cout << response.substr(response.find('\n') + 1);
+    return 0;
+}
+
 int main(int args, char* argv[]) {
+    try {
+        if ((args >= 3) && (string(argv[1]) == "--batch")) return runBatch(args, argv);
+        if ((args >= 3) && (string(argv[1]) == "--verify-decode")) return runVerifyDecode(args, argv);
+        if ((args >= 4) && (string(argv[1]) == "--crop-search")) return runCropSearch(args, argv);
+        if ((args >= 3) && (string(argv[1]) == "--video")) return runVideo(args, argv);
+        if ((args >= 3) && (string(argv[1]) == "--cluster")) return runCluster(args, argv);
+        if ((args >= 3) && (string(argv[1]) == "--daemon")) return runDaemon(args, argv);
+        if ((args >= 4) && (string(argv[1]) == "--client")) return runClient(args, argv);
+        if ((args >= 4) && (string(argv[2]) == "--cache")) return runCachedImage(args, argv);
+    }
+    catch (const char* e) { cerr << e << endl; return 1; }
+    catch (const exception& e) { cerr << e.what() << endl; return 1; }
+
     if (args != 3) return 0;
     string filename1 = argv[1];
     string filename2 = argv[2];
@@ -22,6 +358,6 @@ int main(int args, char* argv[]) {
         // double duration = (clock() - start) / double(CLOCKS_PER_SEC);
         // cout << endl << "Processing time: " << to_string(duration) << endl << flush;
     }
-    catch (const char* e) { cout << e << endl; }
+    catch (const char* e) { cerr << e << endl; }
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,90 @@
+#include <algorithm>
+#include "hash/phash.h"
+#include "pimg/accumulator.h"
+using namespace std;
+
+/*
+ * Initializes zeroed block sums over the normalization block boundaries of
+ * an image with the supplied dimensions.
+ */
+BlockAccumulator::BlockAccumulator(const GridDimensions& imageDimensions,
+    const uint32_t normalizationDimension) : imageSum({0, 0, 0}), dimensions(imageDimensions),
+    normalizationDimension(normalizationDimension), accumulatedRows(0) {
+    ImagePerceptualHash::computeBlockBoundaries(dimensions.height, normalizationDimension, rowBoundaries);
+    ImagePerceptualHash::computeBlockBoundaries(dimensions.width, normalizationDimension, columnBoundaries);
+    blockSums.reset(new vector<GridSum>(normalizationDimension * normalizationDimension, {0, 0, 0}));
+}
+
+/*
+ * Adds one packed BGR(X) image row (0-indexed, any order) to its block sums.
+ */
+void BlockAccumulator::addRow(const size_t row, const uint8_t* bgrData, const size_t bytesPerPixel) {
+    if ((row >= dimensions.height) || isComplete()) throw "BlockAccumulator Error: Invalid target row.";
+    const size_t blockRow = (upper_bound(rowBoundaries.begin(), rowBoundaries.end(), row) -
+        rowBoundaries.begin()) - 1;
+    GridSum* sums = &(*blockSums)[blockRow * normalizationDimension];
+
+    // sum each block's columns in 32 bits, then widen
+    for (uint32_t col = 0; col < normalizationDimension; col++) {
+        uint32_t red = 0, green = 0, blue = 0;
+        const uint8_t* pixel = bgrData + (columnBoundaries[col] * bytesPerPixel);
+        for (size_t j = columnBoundaries[col]; j < columnBoundaries[col + 1]; j++, pixel += bytesPerPixel) {
+            blue += pixel[0];
+            green += pixel[1];
+            red += pixel[2];
+        }
+        sums[col].red += red;
+        sums[col].green += green;
+        sums[col].blue += blue;
+        imageSum.red += red;
+        imageSum.green += green;
+        imageSum.blue += blue;
+    }
+    if (++accumulatedRows == dimensions.height) finishBlocks();
+}
+
+/*
+ * Clears block sums so the accumulator (and its reduced grid) can take
+ * another image of the same dimensions, such as the next video frame.
+ */
+void BlockAccumulator::reset(void) {
+    fill((*blockSums).begin(), (*blockSums).end(), GridSum({0, 0, 0}));
+    imageSum = {0, 0, 0};
+    accumulatedRows = 0;
+}
+
+/*
+ * Converts block sums into the truncated block means of the reduced grid.
+ */
+void BlockAccumulator::finishBlocks(void) {
+    if (normalizedGrid == nullptr) 
+        normalizedGrid.reset(new PixelGrid({normalizationDimension, normalizationDimension}));
+    for (uint32_t row = 0; row < normalizationDimension; row++) {
+        GridPixel* pixels = normalizedGrid->getRow(row);
+        const GridSum* sums = &(*blockSums)[row * normalizationDimension];
+        const size_t blockHeight = rowBoundaries[row + 1] - rowBoundaries[row];
+        for (uint32_t col = 0; col < normalizationDimension; col++) {
+            const size_t blockDivisor = blockHeight * (columnBoundaries[col + 1] - columnBoundaries[col]);
+            pixels[col] = {uint8_t(sums[col].red / blockDivisor), uint8_t(sums[col].green / blockDivisor),
+                uint8_t(sums[col].blue / blockDivisor)};
+        }
+    }
+}
+
+/*
+ * Returns truncated RGB mean of the whole image.
+ */
+GridPixel BlockAccumulator::getImageMean(void) const {
+    if (!isComplete()) throw "BlockAccumulator Error: Image rows still missing.";
+    const size_t imageDivisor = dimensions.height * dimensions.width;
+    return {uint8_t(imageSum.red / imageDivisor), uint8_t(imageSum.green / imageDivisor),
+        uint8_t(imageSum.blue / imageDivisor)};
+}
+
+/*
+ * Frees dynamic memory.
+ */
+BlockAccumulator::~BlockAccumulator(void) {
+    normalizedGrid.reset(nullptr);
+    blockSums.reset(nullptr);
+}
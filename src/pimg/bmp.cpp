@@ -5,6 +5,11 @@
 #include <random>
 #include <regex>
 #include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <opencv2/opencv.hpp>
 #include "pimg/bmp.h"
 using namespace std;
@@ -12,16 +17,33 @@ using namespace std;
 #define BMP_HEADER_SIZE 14
 #define COLOR_ENDPOINTS_SIZE 36
 #define BITMAP_INFO_HEADER_SIZE 40
+#define BITMAP_V5_HEADER_SIZE 124
+#define BMP_SIGNATURE 0x4D42
+#define BMP_COMPRESSION_RGB 0
+#define FAST_DECODE_MIN_BLOCK_SIDE 8 // decoded pixels per normalized block side
 
 static const char alphaNumLib[] = {'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 
     'K', 'L', 'M', 'N', 'O', 'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'Y', 'X', 'Z',
     '0', '1', '2', '3', '4', '5', '6', '7', '8', '9'};
 
 /*
- * Opens supplied filename and saves file session.
+ * Reads little-endian header field from unaligned mapped memory.
  */
-BMPImage::BMPImage(const string& filename, const bool expediteLoad) : loadedFlag(false), 
-    expediteLoad(expediteLoad), file(nullptr), imageGrid(nullptr) {
+template <typename T>
+static inline T readField(const uint8_t* data) {
+    T value;
+    memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+/*
+ * Decodes supplied filename and either holds the decoded image in memory or
+ * saves a converted BMP file session.
+ */
+BMPImage::BMPImage(const string& filename, const bool expediteLoad, const bool memoryLoad, 
+    ImageMetrics* metrics, const uint32_t fastDecodeDimension, BufferPool* pool) : loadedFlag(false), 
+    expediteLoad(expediteLoad), memoryLoad(memoryLoad), decodeReduction(1), mappedData(nullptr), 
+    mappedSize(0), topDownFlag(false), file(nullptr), imageGrid(nullptr), metrics(metrics), pool(pool) {
 
     // validate filename
     string validFilename = filename;
@@ -31,19 +53,49 @@ BMPImage::BMPImage(const string& filename, const bool expediteLoad) : loadedFlag
     if (!regex_match(validFilename, r)) 
         throw "BMPImage Error: Invalid image or filename format.";
 
+    // map uncompressed bmp files directly
+    if (memoryLoad && (validFilename.substr(validFilename.size() - 4) == ".bmp") && 
+        mapBMPFile(filename)) return;
+
+    // pick reduced jpeg decode scale from the frame header
+    int decodeFlags = cv::IMREAD_COLOR;
+    uint32_t jpegWidth, jpegHeight;
+    if (fastDecodeDimension && regex_match(validFilename, regex("^.*[.](jpeg|jpg)$")) && 
+        readJPEGDimensions(filename, jpegWidth, jpegHeight)) {
+        decodeReduction = selectDecodeReduction(jpegWidth, jpegHeight, fastDecodeDimension);
+        if (decodeReduction == 2) decodeFlags = cv::IMREAD_REDUCED_COLOR_2;
+        else if (decodeReduction == 4) decodeFlags = cv::IMREAD_REDUCED_COLOR_4;
+        else if (decodeReduction == 8) decodeFlags = cv::IMREAD_REDUCED_COLOR_8;
+    }
+
+    // decode image
+    {
+        StageTimer timer(metrics, DECODE_STAGE);
+        cv::Mat image = cv::imread(filename, decodeFlags);
+        if (image.data == NULL) throw "BMPImage Error: Failed to convert file.";
+        adoptDecodedImage(image);
+    }
+    if (metrics != nullptr) {
+        struct stat fileStat;
+        if (!stat(filename.c_str(), &fileStat)) metrics->bytesRead += fileStat.st_size;
+        recordAllocation(metrics, decodedImage.total() * decodedImage.elemSize());
+    }
+    if (memoryLoad) {
+        synthesizeHeaders();
+        return;
+    }
+    StageTimer timer(metrics, BMP_WRITE_STAGE);
+
     // generate random identifier string
     string identifier;
     minstd_rand0 rv(chrono::system_clock::now().time_since_epoch().count());
     for (uint8_t i = 0; i < 16; i++) identifier += alphaNumLib[rv() % 30];
 
     // convert to bmp
-    cv::Mat imageBMP;
     const string basename = validFilename.substr(0, validFilename.find('.'));
-    cv::Mat image = cv::imread(filename, cv::IMREAD_COLOR);
-    if (image.data == NULL) throw "BMPImage Error: Failed to convert file.";
-    image.convertTo(imageBMP, CV_8UC3);
-    cv::imwrite(basename + "-" + identifier + ".bmp", imageBMP);
+    cv::imwrite(basename + "-" + identifier + ".bmp", decodedImage);
     bmpFileName = basename + "-" + identifier + ".bmp";
+    decodedImage.release();
 
     // open file
     file = fopen(bmpFileName.c_str(), "rb");
@@ -51,10 +103,216 @@ BMPImage::BMPImage(const string& filename, const bool expediteLoad) : loadedFlag
 }
 
 /*
- * Parses BMP file and individually loads header, info header, and pixel data.
+ * Decodes supplied encoded image bytes and holds the decoded image in memory.
+ */
+BMPImage::BMPImage(const vector<uint8_t>& encodedImage, ImageMetrics* metrics, BufferPool* pool) : 
+    loadedFlag(false), expediteLoad(true), memoryLoad(true), decodeReduction(1), mappedData(nullptr), 
+    mappedSize(0), topDownFlag(false), file(nullptr), imageGrid(nullptr), metrics(metrics), pool(pool) {
+    {
+        StageTimer timer(metrics, DECODE_STAGE);
+        cv::Mat image = cv::imdecode(encodedImage, cv::IMREAD_COLOR);
+        if (image.data == NULL) throw "BMPImage Error: Failed to decode image bytes.";
+        adoptDecodedImage(image);
+    }
+    if (metrics != nullptr) {
+        metrics->bytesRead += encodedImage.size();
+        recordAllocation(metrics, decodedImage.total() * decodedImage.elemSize());
+    }
+    synthesizeHeaders();
+}
+
+/*
+ * Reads frame dimensions from the JPEG start-of-frame marker without 
+ * decoding. Returns false if the file is not a readable JPEG.
+ */
+bool BMPImage::readJPEGDimensions(const string& filename, uint32_t& width, uint32_t& height) {
+    FILE* jpegFile = fopen(filename.c_str(), "rb");
+    if (jpegFile == nullptr) return false;
+    uint8_t marker[4];
+    bool foundFlag = false;
+    if ((fread(marker, 1, 2, jpegFile) == 2) && (marker[0] == 0xFF) && (marker[1] == 0xD8)) {
+
+        // walk marker segments until a frame header
+        while (fread(marker, 1, 2, jpegFile) == 2) {
+            if (marker[0] != 0xFF) break;
+            if ((marker[1] == 0xFF) || (marker[1] == 0x01) || ((marker[1] >= 0xD0) && (marker[1] <= 0xD7))) {
+                if (marker[1] == 0xFF) fseek(jpegFile, -1, SEEK_CUR);
+                continue;
+            }
+            if (fread(marker + 2, 1, 2, jpegFile) != 2) break;
+            const uint32_t segmentLength = (uint32_t(marker[2]) << 8) | marker[3];
+            if (segmentLength < 2) break;
+
+            // SOF0-SOF15, excluding DHT (C4), JPG (C8) and DAC (CC)
+            if ((marker[1] >= 0xC0) && (marker[1] <= 0xCF) && (marker[1] != 0xC4) && 
+                (marker[1] != 0xC8) && (marker[1] != 0xCC)) {
+                uint8_t frame[5];
+                if (fread(frame, 1, 5, jpegFile) != 5) break;
+                height = (uint32_t(frame[1]) << 8) | frame[2];
+                width = (uint32_t(frame[3]) << 8) | frame[4];
+                foundFlag = width && height;
+                break;
+            }
+            if ((marker[1] == 0xDA) || fseek(jpegFile, segmentLength - 2, SEEK_CUR)) break;
+        }
+    }
+    fclose(jpegFile);
+    return foundFlag;
+}
+
+/*
+ * Returns largest JPEG decode reduction (1, 2, 4 or 8) that still leaves 
+ * enough decoded pixels per normalized block on both sides.
+ */
+uint32_t BMPImage::selectDecodeReduction(const uint32_t width, const uint32_t height, 
+    const uint32_t normalizationDimension) {
+    const uint64_t minSide = (uint64_t) normalizationDimension * FAST_DECODE_MIN_BLOCK_SIDE;
+    for (uint32_t reduction = 8; reduction > 1; reduction /= 2)
+        if (((width / reduction) >= minSide) && ((height / reduction) >= minSide)) return reduction;
+    return 1;
+}
+
+/*
+ * Memory-maps BMP file and validates its headers in place. Returns false (and
+ * unmaps) if the layout is not an uncompressed 24/32-bit bitmap.
+ */
+bool BMPImage::mapBMPFile(const string& filename) {
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) throw "BMPImage Error: Failed to open file.";
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) || (fileStat.st_size < BMP_HEADER_SIZE + BITMAP_INFO_HEADER_SIZE)) {
+        close(fd);
+        return false;
+    }
+
+    // map file contents
+    void* data = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    mappedData = (const uint8_t*) data;
+    mappedSize = fileStat.st_size;
+    if (metrics != nullptr) metrics->bytesRead += mappedSize;
+
+    // validate headers in place
+    if (!parseMappedHeaders()) {
+        munmap((void*) mappedData, mappedSize);
+        mappedData = nullptr;
+        mappedSize = 0;
+        return false;
+    }
+    madvise((void*) mappedData, mappedSize, MADV_SEQUENTIAL);
+    return true;
+}
+
+/*
+ * Parses header and info header from mapped file and checks that the pixel
+ * data is supported and fully contained in the mapping.
+ */
+bool BMPImage::parseMappedHeaders(void) {
+    const uint8_t* data = mappedData;
+
+    // parse 14-byte BMP header
+    header.signature = readField<int16_t>(data);
+    header.fileSize = readField<uint32_t>(data + 2);
+    header.dataOffset = readField<uint32_t>(data + 10);
+    if (header.signature != BMP_SIGNATURE) return false;
+
+    // parse info header (BITMAPINFOHEADER through BITMAPV5HEADER)
+    const uint8_t* info = data + BMP_HEADER_SIZE;
+    infoHeader.infoHeaderSize = readField<uint32_t>(info);
+    if ((infoHeader.infoHeaderSize < BITMAP_INFO_HEADER_SIZE) || 
+        (infoHeader.infoHeaderSize > BITMAP_V5_HEADER_SIZE) ||
+        (BMP_HEADER_SIZE + infoHeader.infoHeaderSize > mappedSize)) return false;
+    const int32_t signedWidth = readField<int32_t>(info + 4);
+    const int32_t signedHeight = readField<int32_t>(info + 8);
+    infoHeader.planeCount = readField<uint16_t>(info + 12);
+    infoHeader.bitsPerPixel = readField<uint16_t>(info + 14);
+    infoHeader.compression = readField<uint32_t>(info + 16);
+    infoHeader.imageSize = readField<uint32_t>(info + 20);
+    infoHeader.horizontalResolution = readField<uint32_t>(info + 24);
+    infoHeader.verticalResolution = readField<uint32_t>(info + 28);
+    infoHeader.colorCount = readField<uint32_t>(info + 32);
+    infoHeader.importantColorCount = readField<uint32_t>(info + 36);
+    if ((signedWidth <= 0) || (signedHeight == 0) || (infoHeader.planeCount != 1)) return false;
+    if ((infoHeader.bitsPerPixel != 24) && (infoHeader.bitsPerPixel != 32)) return false;
+    if (infoHeader.compression != BMP_COMPRESSION_RGB) return false;
+
+    // negative height indicates top-down row order
+    topDownFlag = signedHeight < 0;
+    infoHeader.width = signedWidth;
+    infoHeader.height = topDownFlag ? -((int64_t) signedHeight) : signedHeight;
+
+    // check pixel data bounds
+    const size_t rowSize = ((((size_t) infoHeader.bitsPerPixel) * infoHeader.width + 31) / 32) * 4;
+    return ((size_t) header.dataOffset + (rowSize * infoHeader.height)) <= mappedSize;
+}
+
+/*
+ * Loads pixel data from the decoded image, the mapped BMP file or the 
+ * converted BMP file.
  */
 void BMPImage::loadBMPImage(void) {
     if (loadedFlag) throw "BMPImage Error: Image already loaded.";
+    StageTimer timer(metrics, GRID_LOAD_STAGE);
+    if (mappedData != nullptr) loadMappedBMPImage();
+    else if (memoryLoad) loadDecodedImage();
+    else loadBMPFile();
+    if (metrics != nullptr) {
+        metrics->pixelCount += (uint64_t) infoHeader.width * infoHeader.height;
+        if (!(*imageGrid).isRecycled()) recordAllocation(metrics, (*imageGrid).getGridBytes());
+    }
+
+    // set image to loaded
+    loadedFlag = true;
+}
+
+/*
+ * Feeds image rows to the block accumulators in bands without building a 
+ * pixel grid. Mapped BMP bands are released once consumed, so resident 
+ * memory stays proportional to the band size.
+ */
+void BMPImage::streamBMPImage(const vector<BlockAccumulator*>& accumulators, const size_t bandRows) {
+    if (loadedFlag) throw "BMPImage Error: Image already loaded.";
+    if ((mappedData == nullptr) && !memoryLoad) throw "BMPImage Error: Streaming requires memory load.";
+    if (!bandRows) throw "BMPImage Error: Invalid band size.";
+    StageTimer timer(metrics, GRID_LOAD_STAGE);
+
+    // stream decoded rows
+    if (mappedData == nullptr) {
+        for (size_t i = 0; i < infoHeader.height; i++) {
+            for (BlockAccumulator* accumulator : accumulators) 
+                accumulator->addRow(i, decodedImage.ptr<uint8_t>(i), 3);
+        }
+        decodedImage.release();
+    }
+
+    // stream mapped file bands, dropping each band's pages once consumed
+    else {
+        const size_t bytesPerPixel = infoHeader.bitsPerPixel / 8;
+        const size_t rowSize = ((((size_t) infoHeader.bitsPerPixel) * infoHeader.width + 31) / 32) * 4;
+        const size_t pageSize = sysconf(_SC_PAGESIZE);
+        const uintptr_t pixelStart = (uintptr_t) (mappedData + header.dataOffset);
+        for (size_t band = 0; band < infoHeader.height; band += bandRows) {
+            const size_t bandEnd = min(band + bandRows, (size_t) infoHeader.height);
+            for (size_t i = band; i < bandEnd; i++) {
+                const size_t row = topDownFlag ? i : (infoHeader.height - i - 1);
+                for (BlockAccumulator* accumulator : accumulators) 
+                    accumulator->addRow(row, (const uint8_t*) (pixelStart + (i * rowSize)), bytesPerPixel);
+            }
+            const uintptr_t releaseStart = (pixelStart + (band * rowSize)) & ~(pageSize - 1);
+            const uintptr_t releaseEnd = (pixelStart + (bandEnd * rowSize)) & ~(pageSize - 1);
+            if (releaseEnd > releaseStart) 
+                madvise((void*) releaseStart, releaseEnd - releaseStart, MADV_DONTNEED);
+        }
+    }
+    if (metrics != nullptr) metrics->pixelCount += (uint64_t) infoHeader.width * infoHeader.height;
+    loadedFlag = true;
+}
+
+/*
+ * Parses BMP file and individually loads header, info header, and pixel data.
+ */
+void BMPImage::loadBMPFile(void) {
     if (fseek(file, 0, SEEK_SET)) throw "BMPImage Error: Failed to seek pixel data.";
 
     // read 14-byte BMP header
@@ -98,28 +356,76 @@ void BMPImage::loadBMPImage(void) {
     // read pixel image data
     EXPEDITE_READ_DATA: const size_t bytesPerPixel = infoHeader.bitsPerPixel / 8;
     if (fseek(file, header.dataOffset, SEEK_SET)) throw "BMPImage Error: Failed to seek pixel data."; 
-    imageGrid.reset(new PixelGrid({infoHeader.height, infoHeader.width}));
+    imageGrid.reset(new PixelGrid({infoHeader.height, infoHeader.width}, pool, false));
     const size_t rowSize = ceil(((double) (infoHeader.bitsPerPixel * infoHeader.width)) / 32.0) * 4;
+    PoolBuffer<uint8_t> pixelBuf(rowSize, pool, false);
     for (ssize_t i = (infoHeader.height - 1); i >= 0; i--) {
         bytesRead = 0;
-        uint8_t pixelBuf[rowSize];
-        do { bytesRead += fread(pixelBuf + bytesRead, sizeof(uint8_t), rowSize, file); }
+        do { bytesRead += fread(&pixelBuf[bytesRead], sizeof(uint8_t), rowSize - bytesRead, file); }
         while (bytesRead < rowSize);
-        for (size_t j = 0; j < infoHeader.width; j++) {
-            (*imageGrid).setPixel({(uint32_t) (i + 1), (uint32_t) (j + 1)}, {pixelBuf[(j * bytesPerPixel) + 2], 
-                pixelBuf[(j * bytesPerPixel) + 1], pixelBuf[j * bytesPerPixel]});
-        }
+        (*imageGrid).setPixelRow(i + 1, pixelBuf.get(), bytesPerPixel);
     }
+    if (metrics != nullptr) metrics->bytesRead += header.dataOffset + (rowSize * infoHeader.height);
+}
 
-    // set image to loaded
-    loadedFlag = true;
+/*
+ * Swizzles each padded row of the mapped BMP file into the pixel grid.
+ */
+void BMPImage::loadMappedBMPImage(void) {
+    const size_t bytesPerPixel = infoHeader.bitsPerPixel / 8;
+    const size_t rowSize = ((((size_t) infoHeader.bitsPerPixel) * infoHeader.width + 31) / 32) * 4;
+    imageGrid.reset(new PixelGrid({infoHeader.height, infoHeader.width}, pool, false));
+
+    // copy rows in file order
+    const uint8_t* rowData = mappedData + header.dataOffset;
+    for (size_t i = 0; i < infoHeader.height; i++, rowData += rowSize) {
+        const uint32_t row = topDownFlag ? (i + 1) : (infoHeader.height - i);
+        (*imageGrid).setPixelRow(row, rowData, bytesPerPixel);
+    }
+}
+
+/*
+ * Synthesizes the 24-bit BMP headers equivalent to the decoded image.
+ */
+void BMPImage::synthesizeHeaders(void) {
+    const size_t width = decodedImage.cols, height = decodedImage.rows;
+    const size_t rowSize = ((24 * width + 31) / 32) * 4;
+    header.signature = 0x4D42;
+    header.dataOffset = BMP_HEADER_SIZE + BITMAP_INFO_HEADER_SIZE;
+    header.fileSize = header.dataOffset + (rowSize * height);
+    infoHeader = {BITMAP_INFO_HEADER_SIZE, (uint32_t) width, (uint32_t) height, 1, 24, 0, 
+        (uint32_t) (rowSize * height), 0, 0, 0, 0};
+}
+
+/*
+ * Holds decoded image, sharing 8-bit BGR decoder output instead of copying it.
+ */
+void BMPImage::adoptDecodedImage(const cv::Mat& image) {
+    if (image.type() == CV_8UC3) decodedImage = image;
+    else image.convertTo(decodedImage, CV_8UC3);
+}
+
+/*
+ * Fills pixel grid directly from decoded BGR rows.
+ */
+void BMPImage::loadDecodedImage(void) {
+    const size_t width = decodedImage.cols, height = decodedImage.rows;
+
+    // copy decoded rows into grid
+    imageGrid.reset(new PixelGrid({height, width}, pool, false));
+    for (size_t i = 0; i < height; i++)
+        (*imageGrid).setPixelRow(i + 1, decodedImage.ptr<uint8_t>(i), 3);
+    decodedImage.release();
 }
 
 /*
  * Closes file and frees dynamic memory.
  */
 BMPImage::~BMPImage(void) {
-    fclose(file);
-    if (remove(bmpFileName.c_str())) cerr << "BMPImage Error: Failed to clean myself." << endl; 
+    if (mappedData != nullptr) munmap((void*) mappedData, mappedSize);
+    if (file != nullptr) {
+        fclose(file);
+        if (remove(bmpFileName.c_str())) cerr << "BMPImage Error: Failed to clean myself." << endl; 
+    }
     imageGrid.reset(nullptr);
 }
\ No newline at end of file
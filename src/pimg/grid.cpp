@@ -1,48 +1,132 @@
 #include <iostream>
 #include <string>
-#include <string.h>
+#include <algorithm>
 #include "pimg/grid.h"
 using namespace std;
 
+#define PIXELS_PER_ALIGNMENT (GRID_ROW_ALIGNMENT / sizeof(GridPixel))
+
 /*
- * Initializes and zeroes dynamic grid memory.
+ * Initializes aligned grid memory with rows padded to the alignment boundary,
+ * drawn from the supplied pool when present. Callers that overwrite every row
+ * may skip the zero fill (recycled padding columns then hold stale bytes).
  */
-PixelGrid::PixelGrid(const GridDimensions& d) : dimensions(d), 
-    gridSize(d.width * d.height) {
-    pixelArray.reset(new vector<GridPixel>(gridSize));
-    memset(&(*pixelArray).front(), 0, gridSize * sizeof(GridPixel));
+PixelGrid::PixelGrid(const GridDimensions& d, BufferPool* pool, const bool zeroFill) : logCheckpoint(0), 
+    logSequence(0), loggedTileCount(0), dimensions(d), gridSize(d.width * d.height), rowStride(((d.width + PIXELS_PER_ALIGNMENT - 1) / 
+    PIXELS_PER_ALIGNMENT) * PIXELS_PER_ALIGNMENT) {
+    pixelArray = PoolBuffer<GridPixel>(rowStride * d.height, pool, zeroFill);
 }
 
 /*
  * Retrieves and returns indicated pixel value from grid.
  */
 GridPixel& PixelGrid::getPixel(const GridIndex& i) const {
-    if ((i.column > dimensions.width) || (i.row > dimensions.height))
-        throw "PixelGrid Error: Invalid target index.";
-    const size_t pixelOffset = ((i.row - 1) * dimensions.width) + (i.column - 1); 
-    return (*pixelArray)[pixelOffset];
+    if ((i.column == 0) || (i.row == 0) || (i.column > dimensions.width) || 
+        (i.row > dimensions.height)) throw "PixelGrid Error: Invalid target index.";
+    return getRow(i.row - 1)[i.column - 1];
 }
 
 /*
  * Sets pixel at indiciated location to supplied value.
  */
 void PixelGrid::setPixel(const GridIndex& i, const GridPixel& p) {
-    if ((i.column > dimensions.width) || (i.row > dimensions.height))
+    if ((i.column == 0) || (i.row == 0) || (i.column > dimensions.width) || 
+        (i.row > dimensions.height)) throw "PixelGrid Error: Invalid target index.";
+    getRow(i.row - 1)[i.column - 1] = p;
+    markTile(((i.row - 1) / DIRTY_TILE_SIZE) * getDirtyTileColumns() + ((i.column - 1) / DIRTY_TILE_SIZE));
+}
+
+/*
+ * Records an edit of the indicated block (0-indexed). Writers going through 
+ * getRow must call this for hashes to pick up their changes.
+ */
+void PixelGrid::markDirty(const size_t row, const size_t column, const size_t height, 
+    const size_t width) {
+    if (((row + height) > dimensions.height) || ((column + width) > dimensions.width))
+        throw "PixelGrid Error: Invalid target block.";
+    if (!height || !width) return;
+    const size_t tileColumns = getDirtyTileColumns();
+    for (size_t i = row / DIRTY_TILE_SIZE; i <= (row + height - 1) / DIRTY_TILE_SIZE; i++)
+        for (size_t j = column / DIRTY_TILE_SIZE; j <= (column + width - 1) / DIRTY_TILE_SIZE; j++)
+            markTile(i * tileColumns + j);
+}
+
+/*
+ * Allocates per-tile log sequences. Bulk row writes before any edit or hash
+ * collection skip tracking.
+ */
+void PixelGrid::armTracking(void) const {
+    if (tileSequences.empty()) 
+        tileSequences.resize(getDirtyTileColumns() * ((dimensions.height + DIRTY_TILE_SIZE - 1) / 
+            DIRTY_TILE_SIZE), 0);
+}
+
+/*
+ * Logs tile unless already logged since the last collection checkpoint. A
+ * tile's earlier entries go stale, and are dropped once they outnumber the
+ * tiles in the log (so it holds at most two entries per edited tile).
+ */
+void PixelGrid::markTile(const size_t tile) {
+    armTracking();
+    if (tileSequences[tile] > logCheckpoint) return;
+    if (!tileSequences[tile]) loggedTileCount++;
+    tileSequences[tile] = ++logSequence;
+    dirtyLog.push_back({uint32_t(tile), logSequence});
+    if (dirtyLog.size() >= max((size_t) MIN_DIRTY_LOG_COMPACTION, 2 * loggedTileCount)) compactDirtyLog();
+}
+
+/*
+ * Drops log entries superseded by a later entry of the same tile. Every
+ * position handed out stays valid, as sequences are kept.
+ */
+void PixelGrid::compactDirtyLog(void) {
+    size_t kept = 0;
+    for (const DirtyTileEntry& entry : dirtyLog) {
+        if (tileSequences[entry.tile] == entry.sequence) dirtyLog[kept++] = entry;
+    }
+    dirtyLog.resize(kept);
+}
+
+/*
+ * Appends every tile logged since the supplied log position (once each) and
+ * returns the current log position. Later edits of the returned tiles are 
+ * logged again.
+ */
+size_t PixelGrid::collectDirtyTiles(const size_t since, vector<uint32_t>& tiles) const {
+    armTracking();
+    const auto first = upper_bound(dirtyLog.begin(), dirtyLog.end(), since, 
+        [](const size_t sequence, const DirtyTileEntry& entry) { return sequence < entry.sequence; });
+    for (auto entry = first; entry != dirtyLog.end(); entry++) {
+        if (tileSequences[entry->tile] == entry->sequence) tiles.push_back(entry->tile);
+    }
+    logCheckpoint = logSequence;
+    return logCheckpoint;
+}
+
+/*
+ * Sets entire row at indicated location from packed BGR(X) pixel data.
+ */
+void PixelGrid::setPixelRow(const uint32_t row, const uint8_t* bgrData, 
+    const size_t bytesPerPixel) {
+    if ((row == 0) || (row > dimensions.height))
         throw "PixelGrid Error: Invalid target index.";
-    const size_t pixelOffset = ((i.row - 1) * dimensions.width) + (i.column - 1); 
-    (*pixelArray)[pixelOffset] = p;
+    GridPixel* rowPixels = getRow(row - 1);
+    for (size_t j = 0; j < dimensions.width; j++, bgrData += bytesPerPixel)
+        rowPixels[j] = {bgrData[2], bgrData[1], bgrData[0]};
+    if (!tileSequences.empty()) markDirty(row - 1, 0, 1, dimensions.width);
 }
 
 /*
  * Prints RGB pixel value of entire grid.
  */
 void PixelGrid::printPixelGrid(void) const {    
-    vector<GridPixel>& g = *pixelArray;
-    for (size_t i = 0; i < gridSize; i++) {
-        if ((i % dimensions.width) == 0) cout << endl << "Row: " 
-            << (i / dimensions.width) + 1 << endl << flush;
-        cout << "(" << to_string(g[i].red) << ", " << to_string(g[i].green) 
-            << ", " << to_string(g[i].blue) << ")" << endl << flush;
+    for (size_t i = 0; i < dimensions.height; i++) {
+        const GridPixel* g = getRow(i);
+        cout << endl << "Row: " << i + 1 << endl << flush;
+        for (size_t j = 0; j < dimensions.width; j++) {
+            cout << "(" << to_string(g[j].red) << ", " << to_string(g[j].green) 
+                << ", " << to_string(g[j].blue) << ")" << endl << flush;
+        }
     }
 }
 
@@ -50,5 +134,5 @@ void PixelGrid::printPixelGrid(void) const {
  * Frees dynamic memory.
  */
 PixelGrid::~PixelGrid(void) {
-    pixelArray.reset(nullptr);
+    pixelArray.reset();
 }
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include <string.h>
+#include "pimg/integral.h"
+using namespace std;
+
+// largest block whose 8-bit channel sum still fits the 32-bit tables
+#define MAX_BLOCK_AREA (UINT32_MAX / UINT8_MAX)
+
+/*
+ * Builds per-channel summed-area tables in a single pass over the grid. Only
+ * the zero padding row and column are cleared; every other entry is written.
+ */
+IntegralGrid::IntegralGrid(const PixelGrid& grid, BufferPool* pool) : dimensions({grid.getGridHeight(), 
+    grid.getGridWidth()}), tableWidth(grid.getGridWidth() + 1), gridSum({0, 0, 0}) {
+    const size_t tableSize = (dimensions.height + 1) * tableWidth;
+    redTable = PoolBuffer<uint32_t>(tableSize, pool, false);
+    greenTable = PoolBuffer<uint32_t>(tableSize, pool, false);
+    blueTable = PoolBuffer<uint32_t>(tableSize, pool, false);
+    uint32_t* red = redTable.get();
+    uint32_t* green = greenTable.get();
+    uint32_t* blue = blueTable.get();
+    memset(red, 0, sizeof(uint32_t) * tableWidth);
+    memset(green, 0, sizeof(uint32_t) * tableWidth);
+    memset(blue, 0, sizeof(uint32_t) * tableWidth);
+
+    // accumulate row prefix sums onto the previous table row
+    for (size_t i = 0; i < dimensions.height; i++) {
+        const GridPixel* pixels = grid.getRow(i);
+        const size_t above = i * tableWidth, current = above + tableWidth;
+        red[current] = green[current] = blue[current] = 0;
+        uint32_t rowRed = 0, rowGreen = 0, rowBlue = 0;
+        for (size_t j = 0; j < dimensions.width; j++) {
+            rowRed += pixels[j].red;
+            rowGreen += pixels[j].green;
+            rowBlue += pixels[j].blue;
+            red[current + j + 1] = red[above + j + 1] + rowRed;
+            green[current + j + 1] = green[above + j + 1] + rowGreen;
+            blue[current + j + 1] = blue[above + j + 1] + rowBlue;
+        }
+
+        // update exact grid sums
+        gridSum.red += rowRed;
+        gridSum.green += rowGreen;
+        gridSum.blue += rowBlue;
+    }
+}
+
+/*
+ * Returns RGB sums of the indicated block (0-indexed) in constant time.
+ */
+GridSum IntegralGrid::getBlockSum(const size_t row, const size_t column, const size_t height, 
+    const size_t width) const {
+    if (((row + height) > dimensions.height) || ((column + width) > dimensions.width))
+        throw "IntegralGrid Error: Invalid target block.";
+    if ((height * width) > MAX_BLOCK_AREA) throw "IntegralGrid Error: Block too large.";
+
+    // inclusion-exclusion is exact modulo 2^32 for bounded block sums
+    const size_t topLeft = (row * tableWidth) + column, topRight = topLeft + width;
+    const size_t bottomLeft = topLeft + (height * tableWidth), bottomRight = bottomLeft + width;
+    const uint32_t* r = redTable.get();
+    const uint32_t* g = greenTable.get();
+    const uint32_t* b = blueTable.get();
+    return {uint32_t(r[bottomRight] - r[bottomLeft] - r[topRight] + r[topLeft]),
+        uint32_t(g[bottomRight] - g[bottomLeft] - g[topRight] + g[topLeft]),
+        uint32_t(b[bottomRight] - b[bottomLeft] - b[topRight] + b[topLeft])};
+}
+
+/*
+ * Returns truncated RGB mean of the indicated block (0-indexed).
+ */
+GridPixel IntegralGrid::getBlockMean(const size_t row, const size_t column, const size_t height, 
+    const size_t width) const {
+    if ((height == 0) || (width == 0)) throw "IntegralGrid Error: Invalid target block.";
+    const GridSum sum = getBlockSum(row, column, height, width);
+    const size_t blockDivisor = height * width;
+    return {uint8_t(sum.red / blockDivisor), uint8_t(sum.green / blockDivisor), 
+        uint8_t(sum.blue / blockDivisor)};
+}
+
+/*
+ * Frees dynamic memory.
+ */
+IntegralGrid::~IntegralGrid(void) {
+    redTable.reset();
+    greenTable.reset();
+    blueTable.reset();
+}
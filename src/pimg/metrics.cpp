@@ -0,0 +1,121 @@
+#include <iostream>
+#include <cstdio>
+#include "pimg/metrics.h"
+using namespace std;
+
+static const char* stageNames[METRIC_STAGE_COUNT] = {"decode", "bmpWrite", "gridLoad",
+    "integral", "normalize", "hash"};
+
+/*
+ * Zeroes every histogram bucket.
+ */
+MetricsHistogram::MetricsHistogram(void) : imageCount(0) {
+    Histogram* histograms[METRIC_STAGE_COUNT + 5] = {&totalHistogram, &bytesHistogram, 
+        &pixelHistogram, &allocationCountHistogram, &allocatedBytesHistogram};
+    for (uint32_t s = 0; s < METRIC_STAGE_COUNT; s++) histograms[s + 5] = &stageHistograms[s];
+    for (Histogram* histogram : histograms) {
+        for (atomic<uint64_t>& bucket : histogram->buckets) bucket = 0;
+        histogram->total = 0;
+        histogram->maximum = 0;
+    }
+}
+
+/*
+ * Returns JSON key of the indicated stage.
+ */
+const char* MetricsHistogram::getStageName(const MetricStage stage) {
+    return stageNames[stage];
+}
+
+/*
+ * Adds one image's metrics to the batch histograms.
+ */
+void MetricsHistogram::record(const ImageMetrics& metrics) {
+    for (uint32_t s = 0; s < METRIC_STAGE_COUNT; s++) recordValue(stageHistograms[s], metrics.stageTimes[s]);
+    recordValue(totalHistogram, metrics.totalTime);
+    recordValue(bytesHistogram, metrics.bytesRead);
+    recordValue(pixelHistogram, metrics.pixelCount);
+    recordValue(allocationCountHistogram, metrics.allocationCount);
+    recordValue(allocatedBytesHistogram, metrics.allocatedBytes);
+    imageCount.fetch_add(1, memory_order_relaxed);
+}
+
+/*
+ * Counts value in its log2 bucket (bucket i holds [2^(i-1), 2^i), bucket 0 holds 0).
+ */
+void MetricsHistogram::recordValue(Histogram& histogram, const uint64_t value) {
+    const uint32_t bucket = value ? min(64 - __builtin_clzll(value), METRIC_HISTOGRAM_BUCKETS - 1) : 0;
+    histogram.buckets[bucket].fetch_add(1, memory_order_relaxed);
+    histogram.total.fetch_add(value, memory_order_relaxed);
+    uint64_t maximum = histogram.maximum.load(memory_order_relaxed);
+    while ((value > maximum) && !histogram.maximum.compare_exchange_weak(maximum, value,
+        memory_order_relaxed));
+}
+
+/*
+ * Writes one histogram as {total, max, buckets: {lower bound: count}}.
+ */
+void MetricsHistogram::writeHistogramJSON(ostream& out, const Histogram& histogram) {
+    out << "{\"total\": " << histogram.total.load() << ", \"max\": " << histogram.maximum.load()
+        << ", \"buckets\": {";
+    bool first = true;
+    for (uint32_t i = 0; i < METRIC_HISTOGRAM_BUCKETS; i++) {
+        const uint64_t count = histogram.buckets[i].load();
+        if (!count) continue;
+        out << (first ? "" : ", ") << "\"" << (i ? (uint64_t(1) << (i - 1)) : 0) << "\": " << count;
+        first = false;
+    }
+    out << "}}";
+}
+
+/*
+ * Writes batch histograms as a JSON object (times in nanoseconds).
+ */
+void MetricsHistogram::writeJSON(ostream& out) const {
+    out << "{" << endl << "  \"images\": " << imageCount.load() << "," << endl << "  \"stages\": {" << endl;
+    for (uint32_t s = 0; s < METRIC_STAGE_COUNT; s++) {
+        out << "    \"" << stageNames[s] << "\": ";
+        writeHistogramJSON(out, stageHistograms[s]);
+        out << ((s + 1) < METRIC_STAGE_COUNT ? "," : "") << endl;
+    }
+    out << "  }," << endl << "  \"total\": ";
+    writeHistogramJSON(out, totalHistogram);
+    out << "," << endl << "  \"bytesRead\": ";
+    writeHistogramJSON(out, bytesHistogram);
+    out << "," << endl << "  \"pixels\": ";
+    writeHistogramJSON(out, pixelHistogram);
+    out << "," << endl << "  \"allocationCount\": ";
+    writeHistogramJSON(out, allocationCountHistogram);
+    out << "," << endl << "  \"allocatedBytes\": ";
+    writeHistogramJSON(out, allocatedBytesHistogram);
+    out << endl << "}" << endl;
+}
+
+/*
+ * Writes one image's metrics as a single-line JSON object.
+ */
+void MetricsHistogram::writeImageJSON(ostream& out, const string& filename, const ImageMetrics& metrics) {
+    out << "{\"file\": \"" << escapeJSON(filename) << "\", \"stages\": {";
+    for (uint32_t s = 0; s < METRIC_STAGE_COUNT; s++)
+        out << (s ? ", " : "") << "\"" << stageNames[s] << "\": " << metrics.stageTimes[s];
+    out << "}, \"total\": " << metrics.totalTime << ", \"bytesRead\": " << metrics.bytesRead
+        << ", \"pixels\": " << metrics.pixelCount << ", \"allocations\": " << metrics.allocationCount
+        << ", \"allocatedBytes\": " << metrics.allocatedBytes << "}" << endl;
+}
+
+/*
+ * Escapes quotes, backslashes and control characters for a JSON string.
+ */
+string escapeJSON(const string& text) {
+    string escaped;
+    char code[7];
+    for (const char c : text) {
+        if ((c == '"') || (c == '\\')) escaped += string("\\") + c;
+        else if ((unsigned char) c < 0x20) {
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
+        }
+        else escaped += c;
+    }
+    return escaped;
+}
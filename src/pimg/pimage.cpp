@@ -1,25 +1,147 @@
 #include <iostream>
+#include <chrono>
+#include <algorithm>
+#include "pimg/integral.h"
 #include "pimg/pimage.h"
 using namespace std;
 
 /*
- * Initialize pure image object with supplied filename.
+ * Initialize pure image object with supplied filename, hashing once for each
+ * requested normalization size. Fast decode lets JPEGs decode at a reduced 
+ * scale sized to the largest normalization size. Streaming load accumulates 
+ * block means in row bands and never builds the full pixel grid. A buffer 
+ * pool lets callers hashing many images recycle grid and table memory.
  */
-PureImage::PureImage(const string& filename, bool verbose) : 
-    filename(filename) {
+PureImage::PureImage(const string& filename, bool verbose, 
+    const vector<uint32_t>& normalizationSizes, const bool fastDecode, const bool streamLoad, 
+    BufferPool* pool) : filename(filename), pool(pool), metrics() {
+    if (normalizationSizes.empty()) throw "PureImage Error: No normalization size supplied.";
+    const chrono::steady_clock::time_point start = chrono::steady_clock::now();
 
-    // load pure image contents
-    image.reset(new BMPImage(filename));
-    imagePHash = ImagePerceptualHash(image->getBMPPixelGrid());
+    // load pure image contents in memory
+    const uint32_t fastDecodeDimension = fastDecode ? 
+        *max_element(normalizationSizes.begin(), normalizationSizes.end()) : 0;
+    image.reset(new BMPImage(filename, true, true, &metrics, fastDecodeDimension, pool));
+    hashImage(verbose, normalizationSizes, streamLoad);
+    metrics.totalTime = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - 
+        start).count();
+}
+
+/*
+ * Initialize pure image object from encoded image bytes (any format OpenCV 
+ * decodes), labelled with the supplied name.
+ */
+PureImage::PureImage(const string& name, const vector<uint8_t>& encodedImage, 
+    const vector<uint32_t>& normalizationSizes, const bool streamLoad, BufferPool* pool) : 
+    filename(name), pool(pool), metrics() {
+    if (normalizationSizes.empty()) throw "PureImage Error: No normalization size supplied.";
+    const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    image.reset(new BMPImage(encodedImage, &metrics, pool));
+    hashImage(false, normalizationSizes, streamLoad);
+    metrics.totalTime = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - 
+        start).count();
+}
+
+/*
+ * Loads (or streams) the decoded image and hashes it at every normalization size.
+ */
+void PureImage::hashImage(const bool verbose, const vector<uint32_t>& normalizationSizes, 
+    const bool streamLoad) {
+
+    // stream row bands into per-size block accumulators
+    if (streamLoad) {
+        const GridDimensions dimensions = {image->getBMPImageHeight(), image->getBMPImageWidth()};
+        vector<BlockAccumulator*> sinks;
+        for (const uint32_t normalizationSize : normalizationSizes) {
+            accumulators.emplace_back(new BlockAccumulator(dimensions, normalizationSize));
+            sinks.push_back(accumulators.back().get());
+        }
+        image->streamBMPImage(sinks);
+        for (const unique_ptr<BlockAccumulator>& accumulator : accumulators) {
+            imagePHashes.emplace_back(new ImagePerceptualHash(accumulator->getNormalizedGrid(), 
+                accumulator->getNormalizationDimension(), &metrics, pool));
+            imagePHashes.back()->executeHash(*accumulator);
+        }
+        if (verbose) cout << "Finished streaming pure image." << endl << flush;
+        return;
+    }
     image->loadBMPImage();
-    imagePHash.executeHash();
+
+    // hash a single size by direct block sums (tables only pay off across sizes)
+    if (normalizationSizes.size() == 1) {
+        imagePHashes.emplace_back(new ImagePerceptualHash(image->getBMPPixelGrid(), normalizationSizes.front(), 
+            &metrics, pool));
+        imagePHashes.back()->executeHash();
+        if (verbose) cout << "Finished loading pure image." << endl << flush;
+        return;
+    }
+
+    // hash every size from one set of summed-area tables
+    unique_ptr<IntegralGrid> integralGrid;
+    {
+        StageTimer timer(&metrics, INTEGRAL_STAGE);
+        integralGrid.reset(new IntegralGrid(image->getBMPPixelGrid(), pool));
+        if (!integralGrid->isRecycled()) recordAllocation(&metrics, integralGrid->getTableBytes());
+    }
+    for (const uint32_t normalizationSize : normalizationSizes) {
+        imagePHashes.emplace_back(new ImagePerceptualHash(image->getBMPPixelGrid(), normalizationSize, 
+            &metrics, pool));
+        imagePHashes.back()->executeHash(*integralGrid);
+    }
     if (verbose) 
         cout << "Finished loading pure image." << endl << flush;
 }
 
+/*
+ * Hashes file with full and fast decode and returns the worst per-channel bit 
+ * error ratio between the two hashes.
+ */
+float PureImage::measureFastDecodeDrift(const string& filename, const uint32_t normalizationSize) {
+    PureImage fullImage(filename, false, {normalizationSize}, false);
+    PureImage fastImage(filename, false, {normalizationSize}, true);
+    const IPHSErrorDiagnosis drift = ImagePerceptualHash::compareHashes(fullImage.getPHash(), 
+        fastImage.getPHash(), false, normalizationSize);
+    return max({drift.redErrorRat, drift.greenErrorRat, drift.blueErrorRat, drift.luminanceErrorRat, 
+        drift.grayscaleErrorRat, drift.combined1ErrorRat, drift.combined2ErrorRat});
+}
+
+/*
+ * Returns perceptual hash computed at the indicated normalization size.
+ */
+ImagePerceptualHash& PureImage::getPHash(const uint32_t normalizationSize) {
+    for (unique_ptr<ImagePerceptualHash>& imagePHash : imagePHashes)
+        if (imagePHash->getNormalizationDimension() == normalizationSize) return *imagePHash;
+    throw "PureImage Error: Normalization size not hashed.";
+}
+
+/*
+ * Re-hashes every normalization size after edits made through the pixel 
+ * grid, touching only the normalized blocks the edits fall in. The token
+ * hash is recomputed on next use.
+ */
+void PureImage::updateHashes(void) {
+    if (!accumulators.empty()) throw "PureImage Error: Streamed images hold no pixel grid.";
+    for (unique_ptr<ImagePerceptualHash>& imagePHash : imagePHashes) imagePHash->updateHash();
+    tokenPHash.reset(nullptr);
+}
+
+/*
+ * Returns 64-bit DCT token hash, computing it on first use.
+ */
+TokenPerceptualHash& PureImage::getTokenHash(void) {
+    if (tokenPHash == nullptr) {
+        tokenPHash.reset(new TokenPerceptualHash(image->getBMPPixelGrid()));
+        tokenPHash->executeHash();
+    }
+    return *tokenPHash;
+}
+
 /*
  * Free dynamically-allocated memory.
  */
 PureImage::~PureImage() {
+    tokenPHash.reset(nullptr);
+    imagePHashes.clear();
+    accumulators.clear();
     image.reset(nullptr);
-}
\ No newline at end of file
+}
@@ -0,0 +1,88 @@
+#include "pimg/pool.h"
+using namespace std;
+
+/*
+ * Initializes empty pool retaining at most the supplied bytes of free buffers.
+ */
+BufferPool::BufferPool(const size_t maxRetainedBytes) : maxRetainedBytes(maxRetainedBytes),
+    retainedBytes(0), hitCount(0), missCount(0), allocatedBytes(0) {}
+
+/*
+ * Rounds a request up to its capacity class: POOL_CLASS_STEPS even steps
+ * per power of two, never finer than the buffer alignment.
+ */
+size_t BufferPool::getCapacityClass(const size_t bytes) {
+    size_t step = POOL_BUFFER_ALIGNMENT;
+    while ((step * POOL_CLASS_STEPS * 2) <= bytes) step <<= 1;
+    return ((bytes + step - 1) / step) * step;
+}
+
+/*
+ * Returns an aligned buffer of at least the requested size, reusing a
+ * retained buffer of the same or a slightly larger (under twice the size)
+ * capacity class when one is free. Contents of recycled buffers are 
+ * unspecified.
+ */
+void* BufferPool::acquire(const size_t bytes, size_t& capacity, bool& recycled) {
+    capacity = getCapacityClass(bytes);
+    {
+        lock_guard<mutex> poolGuard(poolLock);
+        for (size_t candidate = capacity; candidate < (capacity * 2); 
+            candidate = getCapacityClass(candidate + 1)) {
+            auto buffers = freeBuffers.find(candidate);
+            if ((buffers == freeBuffers.end()) || buffers->second.empty()) continue;
+            void* buffer = buffers->second.back();
+            buffers->second.pop_back();
+            retainedBytes -= candidate;
+            hitCount++;
+            capacity = candidate;
+            recycled = true;
+            return buffer;
+        }
+        missCount++;
+        allocatedBytes += capacity;
+    }
+    recycled = false;
+    return aligned_alloc(POOL_BUFFER_ALIGNMENT, capacity);
+}
+
+/*
+ * Retains buffer for reuse, freeing it instead once the pool is full.
+ */
+void BufferPool::release(void* buffer, const size_t capacity) {
+    {
+        lock_guard<mutex> poolGuard(poolLock);
+        if ((retainedBytes + capacity) <= maxRetainedBytes) {
+            freeBuffers[capacity].push_back(buffer);
+            retainedBytes += capacity;
+            return;
+        }
+    }
+    free(buffer);
+}
+
+/*
+ * Frees every retained buffer.
+ */
+void BufferPool::trim(void) {
+    lock_guard<mutex> poolGuard(poolLock);
+    for (auto& buffers : freeBuffers)
+        for (void* buffer : buffers.second) free(buffer);
+    freeBuffers.clear();
+    retainedBytes = 0;
+}
+
+/*
+ * Returns hit, miss and byte counters.
+ */
+PoolStats BufferPool::getStats(void) const {
+    lock_guard<mutex> poolGuard(poolLock);
+    return {hitCount, missCount, allocatedBytes, retainedBytes};
+}
+
+/*
+ * Frees retained buffers (buffers still held must not outlive the pool).
+ */
+BufferPool::~BufferPool(void) {
+    trim();
+}
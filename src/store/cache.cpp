@@ -0,0 +1,429 @@
+#include <cstdio>
+#include <algorithm>
+#include <unordered_set>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "store/cache.h"
+#include "store/hashdb.h"
+using namespace std;
+
+#define MAX_CACHE_DIMENSION 1024 // larger stored dimensions mark a corrupt entry
+
+static const char cacheMagic[8] = {'P', 'I', 'M', 'G', 'C', 'A', 'C', 'H'};
+
+// content digest multipliers (64-bit primes)
+static const uint64_t digestPrime1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t digestPrime2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t digestPrime3 = 0x165667B19E3779F9ULL;
+
+/*
+ * Mixes one word into a digest lane.
+ */
+static inline uint64_t mixDigestLane(const uint64_t lane, const uint64_t word) {
+    const uint64_t mixed = lane + (word * digestPrime2);
+    return ((mixed << 31) | (mixed >> 33)) * digestPrime1;
+}
+
+/*
+ * Builds the header written to new (or invalidated) cache files.
+ */
+static ResultCacheHeader buildHeader(void) {
+    ResultCacheHeader header;
+    memset(&header, 0, sizeof(ResultCacheHeader));
+    memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = RESULT_CACHE_VERSION;
+    header.algorithmVersion = HASH_ALGORITHM_VERSION;
+    header.headerChecksum = HashDatabase::computeChecksum(&header, sizeof(ResultCacheHeader));
+    return header;
+}
+
+/*
+ * Returns rows of a normalization dimension, or zero if no valid entry has it.
+ */
+static uint32_t getEntryRowCount(const uint32_t dimension) {
+    if (!dimension || (dimension % HASH_DIMENSION_STEP) || (dimension > MAX_CACHE_DIMENSION)) return 0;
+    return (dimension * dimension) / HASH_SEGMENT_SIZE;
+}
+
+/*
+ * Returns checksum of an entry (checksum field zeroed) combined with its rows.
+ */
+static uint32_t computeEntryChecksum(const ResultCacheEntry& entry, const HashRow* rows, const uint32_t rowCount) {
+    ResultCacheEntry unsignedEntry = entry;
+    unsignedEntry.checksum = 0;
+    return HashDatabase::computeChecksum(&unsignedEntry, sizeof(ResultCacheEntry)) ^
+        HashDatabase::computeChecksum(rows, sizeof(HashRow) * rowCount);
+}
+
+/*
+ * Builds an unsigned entry of one dimension under a key.
+ */
+static ResultCacheEntry buildEntry(const CacheFileKey& key, const uint32_t normalizationSize, const uint32_t flags) {
+    ResultCacheEntry entry;
+    memset(&entry, 0, sizeof(ResultCacheEntry));
+    entry.key = key;
+    entry.normalizationDimension = normalizationSize;
+    entry.flags = flags;
+    return entry;
+}
+
+/*
+ * Signs entries and writes each, followed by its rows unless an alias, in
+ * one write (appends from other processes stay whole).
+ */
+static bool writeEntries(const int fd, vector<ResultCacheEntry>& entries, const vector<const HashRow*>& rows) {
+    vector<uint8_t> buffer;
+    for (size_t i = 0; i < entries.size(); i++) {
+        const uint32_t rowCount = (entries[i].flags & CACHE_ENTRY_ALIAS) ? 0 : 
+            getEntryRowCount(entries[i].normalizationDimension);
+        entries[i].checksum = computeEntryChecksum(entries[i], rows[i], rowCount);
+        const size_t offset = buffer.size();
+        buffer.resize(offset + sizeof(ResultCacheEntry) + (sizeof(HashRow) * rowCount));
+        memcpy(&buffer[offset], &entries[i], sizeof(ResultCacheEntry));
+        memcpy(&buffer[offset + sizeof(ResultCacheEntry)], rows[i], sizeof(HashRow) * rowCount);
+    }
+    return write(fd, buffer.data(), buffer.size()) == (ssize_t) buffer.size();
+}
+
+/*
+ * Concatenates stored rows of every dimension in order.
+ */
+static void copyRows(const vector<const HashRow*>& storedRows, const vector<uint32_t>& normalizationSizes, 
+    vector<HashRow>& rows) {
+    rows.clear();
+    for (size_t i = 0; i < normalizationSizes.size(); i++) {
+        rows.insert(rows.end(), storedRows[i], storedRows[i] + getEntryRowCount(normalizationSizes[i]));
+    }
+}
+
+/*
+ * Opens (or creates) cache file and indexes its entries. Files written by
+ * another hash algorithm version are emptied, as their hashes are stale.
+ */
+ResultCache::ResultCache(const string& path) : path(path), fileDescriptor(-1), mappedEntries(nullptr),
+    mappedSize(0), identityHits(0), digestHits(0), misses(0), storedEntries(0) {
+    fileDescriptor = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fileDescriptor < 0) throw "ResultCache Error: Failed to open cache.";
+    try {
+        loadEntries();
+    }
+    catch (const char*) {
+        unmapEntries();
+        if (fileDescriptor >= 0) close(fileDescriptor);
+        throw;
+    }
+}
+
+/*
+ * Computes a 64-bit digest of file contents (four interleaved multiply-rotate
+ * lanes over 8-byte words), far cheaper than decoding the image.
+ */
+uint64_t ResultCache::computeContentDigest(const string& filename) {
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) throw "ResultCache Error: Failed to open file.";
+    struct stat fileStat;
+    if (fstat(fd, &fileStat)) {
+        close(fd);
+        throw "ResultCache Error: Failed to stat file.";
+    }
+    const size_t size = fileStat.st_size;
+    const uint8_t* data = nullptr;
+    if (size) {
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            close(fd);
+            throw "ResultCache Error: Failed to map file.";
+        }
+        madvise(mapped, size, MADV_SEQUENTIAL);
+        data = (const uint8_t*) mapped;
+    }
+    close(fd);
+
+    // mix 32-byte stripes into four lanes
+    uint64_t lanes[4] = {digestPrime1 + digestPrime2, digestPrime2, 0, -digestPrime1};
+    size_t offset = 0;
+    for (; (offset + 32) <= size; offset += 32) {
+        uint64_t words[4];
+        memcpy(words, data + offset, sizeof(words));
+        for (uint32_t l = 0; l < 4; l++) lanes[l] = mixDigestLane(lanes[l], words[l]);
+    }
+
+    // fold lanes, tail bytes and length, then avalanche
+    uint64_t digest = size * digestPrime3;
+    for (uint32_t l = 0; l < 4; l++) digest = (digest ^ mixDigestLane(0, lanes[l])) * digestPrime1 + digestPrime3;
+    for (; offset < size; offset++) digest = ((digest ^ data[offset]) * digestPrime1);
+    digest ^= digest >> 33;
+    digest *= digestPrime2;
+    digest ^= digest >> 29;
+    digest *= digestPrime3;
+    digest ^= digest >> 32;
+    if (size) munmap((void*) data, size);
+    return digest ? digest : 1;
+}
+
+/*
+ * Formats exact map key: file identity (or content digest and size) and
+ * normalization dimension.
+ */
+string ResultCache::formatKey(const CacheFileKey& key, const bool digestFlag, const uint32_t normalizationSize) {
+    const uint64_t fields[5] = {digestFlag ? key.digest : key.device, digestFlag ? 0 : key.inode, key.size,
+        digestFlag ? 0 : key.modifiedTime, normalizationSize};
+    return string((const char*) fields, sizeof(fields));
+}
+
+/*
+ * Formats key of the file an entry was stored for (device and inode) and
+ * its dimension. Later entries of a file supersede earlier ones, whose 
+ * size or modification time no longer match.
+ */
+string ResultCache::formatFileKey(const CacheFileKey& key, const uint32_t normalizationSize) {
+    const uint64_t fields[3] = {key.device, key.inode, normalizationSize};
+    return string((const char*) fields, sizeof(fields));
+}
+
+/*
+ * Maps the cache and indexes every entry in place, truncating the file at
+ * the first partial or corrupt entry (an interrupted append). Caches where
+ * superseded entries have piled up are compacted.
+ */
+void ResultCache::loadEntries(void) {
+    struct stat fileStat;
+    if (fstat(fileDescriptor, &fileStat)) throw "ResultCache Error: Failed to stat cache.";
+    const size_t size = fileStat.st_size;
+
+    // validate header (empty or stale caches restart with a fresh header)
+    ResultCacheHeader header;
+    const bool headerFlag = (size >= sizeof(ResultCacheHeader)) && 
+        (pread(fileDescriptor, &header, sizeof(ResultCacheHeader), 0) == sizeof(ResultCacheHeader));
+    if (headerFlag && memcmp(header.magic, cacheMagic, sizeof(cacheMagic)))
+        throw "ResultCache Error: Not a result cache.";
+    ResultCacheHeader unsignedHeader = header;
+    unsignedHeader.headerChecksum = 0;
+    if (!headerFlag || (header.version != RESULT_CACHE_VERSION) ||
+        (header.algorithmVersion != HASH_ALGORITHM_VERSION) ||
+        (header.headerChecksum != HashDatabase::computeChecksum(&unsignedHeader, sizeof(ResultCacheHeader)))) {
+        header = buildHeader();
+        if (ftruncate(fileDescriptor, 0) ||
+            (write(fileDescriptor, &header, sizeof(ResultCacheHeader)) != sizeof(ResultCacheHeader)))
+            throw "ResultCache Error: Failed to write header.";
+        return;
+    }
+
+    // map entries read-only (appends go through the descriptor)
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+    if (mapped == MAP_FAILED) throw "ResultCache Error: Failed to map cache.";
+    mappedEntries = (const uint8_t*) mapped;
+    mappedSize = size;
+
+    // index entries up to the first invalid one (newer entries replace older ones)
+    unordered_map<string, size_t> fileOffsets; // latest entry of every file and dimension
+    vector<size_t> entryOffsets;
+    size_t offset = sizeof(ResultCacheHeader), entryCount = 0, supersededCount = 0;
+    while ((offset + sizeof(ResultCacheEntry)) <= size) {
+        const ResultCacheEntry& entry = *(const ResultCacheEntry*) (mappedEntries + offset);
+        const bool aliasFlag = entry.flags & CACHE_ENTRY_ALIAS;
+        const uint32_t rowCount = getEntryRowCount(entry.normalizationDimension);
+        if (!rowCount || (entry.flags & ~CACHE_ENTRY_ALIAS)) break;
+        const size_t entrySize = sizeof(ResultCacheEntry) + (aliasFlag ? 0 : (sizeof(HashRow) * rowCount));
+        if ((offset + entrySize) > size) break;
+        const HashRow* rows = (const HashRow*) (mappedEntries + offset + sizeof(ResultCacheEntry));
+        if (computeEntryChecksum(entry, rows, aliasFlag ? 0 : rowCount) != entry.checksum) break;
+        entryCount++;
+
+        // aliases take the rows of their content (dropped if none precede them)
+        const string digestKey = formatKey(entry.key, true, entry.normalizationDimension);
+        const auto source = digestEntries.find(digestKey);
+        if (aliasFlag && (source == digestEntries.end())) supersededCount++;
+        else {
+            if (aliasFlag) rows = source->second;
+            identityEntries[formatKey(entry.key, false, entry.normalizationDimension)] = rows;
+            digestEntries[digestKey] = rows;
+            entryOffsets.push_back(offset);
+            const auto inserted = fileOffsets.insert({formatFileKey(entry.key, entry.normalizationDimension), offset});
+            if (!inserted.second) {
+                inserted.first->second = offset;
+                supersededCount++;
+            }
+        }
+        offset += entrySize;
+    }
+    if ((offset < size) && ftruncate(fileDescriptor, offset))
+        throw "ResultCache Error: Failed to truncate cache.";
+    if (supersededCount && ((supersededCount * CACHE_COMPACT_FRACTION) >= entryCount)) 
+        compactEntries(entryOffsets, fileOffsets);
+}
+
+/*
+ * Rewrites the cache with only the latest entry of every file (device and
+ * inode) and dimension, storing each content's rows once (later files with
+ * the same content become aliases). The compacted file replaces the cache 
+ * by rename and is indexed afresh; appends other processes make to the old
+ * file meanwhile are lost. On failure the current index is kept.
+ */
+void ResultCache::compactEntries(const vector<size_t>& entryOffsets, 
+    const unordered_map<string, size_t>& fileOffsets) {
+
+    // write latest entries to a temporary file
+    const string compactPath = path + ".compact";
+    const int compactDescriptor = open(compactPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (compactDescriptor < 0) return;
+    const ResultCacheHeader header = buildHeader();
+    bool writeFlag = write(compactDescriptor, &header, sizeof(ResultCacheHeader)) == sizeof(ResultCacheHeader);
+    unordered_set<string> writtenDigests;
+    for (size_t i = 0; writeFlag && (i < entryOffsets.size()); i++) {
+        const ResultCacheEntry& entry = *(const ResultCacheEntry*) (mappedEntries + entryOffsets[i]);
+        if (fileOffsets.at(formatFileKey(entry.key, entry.normalizationDimension)) != entryOffsets[i]) continue;
+        const string digestKey = formatKey(entry.key, true, entry.normalizationDimension);
+        const bool aliasFlag = !writtenDigests.insert(digestKey).second;
+        vector<ResultCacheEntry> entries = {buildEntry(entry.key, entry.normalizationDimension, 
+            aliasFlag ? CACHE_ENTRY_ALIAS : 0)};
+        writeFlag = writeEntries(compactDescriptor, entries, {digestEntries[digestKey]});
+    }
+    close(compactDescriptor);
+    if (!writeFlag || rename(compactPath.c_str(), path.c_str())) {
+        unlink(compactPath.c_str());
+        return;
+    }
+
+    // index the compacted file
+    unmapEntries();
+    close(fileDescriptor);
+    fileDescriptor = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fileDescriptor < 0) throw "ResultCache Error: Failed to open cache.";
+    loadEntries();
+}
+
+/*
+ * Drops the index and unmaps the entries it pointed into.
+ */
+void ResultCache::unmapEntries(void) {
+    identityEntries.clear();
+    digestEntries.clear();
+    if (mappedEntries != nullptr) munmap((void*) mappedEntries, mappedSize);
+    mappedEntries = nullptr;
+    mappedSize = 0;
+}
+
+/*
+ * Copies rows appended after open into in-memory blocks (reserved up front,
+ * so rows never move) and returns where they are kept.
+ */
+const HashRow* ResultCache::keepRows(const HashRow* rows, const uint32_t rowCount) {
+    if (appendedRows.empty() || ((appendedRows.back()->capacity() - appendedRows.back()->size()) < rowCount)) {
+        appendedRows.emplace_back(new vector<HashRow>());
+        appendedRows.back()->reserve(max(rowCount, (uint32_t) CACHE_APPEND_BLOCK_ROWS));
+    }
+    vector<HashRow>& block = *appendedRows.back();
+    block.insert(block.end(), rows, rows + rowCount);
+    return &block[block.size() - rowCount];
+}
+
+/*
+ * Appends entries with their rows (aliases point at already indexed rows)
+ * and indexes them.
+ */
+void ResultCache::appendEntries(const vector<ResultCacheEntry>& entries, const vector<const HashRow*>& rows) {
+    vector<ResultCacheEntry> signedEntries = entries;
+    lock_guard<mutex> cacheGuard(cacheLock);
+    if (!writeEntries(fileDescriptor, signedEntries, rows)) throw "ResultCache Error: Failed to append entry.";
+    for (size_t i = 0; i < entries.size(); i++) {
+        const uint32_t normalizationSize = entries[i].normalizationDimension;
+        const HashRow* storedRows = (entries[i].flags & CACHE_ENTRY_ALIAS) ? rows[i] : 
+            keepRows(rows[i], getEntryRowCount(normalizationSize));
+        identityEntries[formatKey(entries[i].key, false, normalizationSize)] = storedRows;
+        digestEntries[formatKey(entries[i].key, true, normalizationSize)] = storedRows;
+        storedEntries++;
+    }
+}
+
+/*
+ * Finds stored rows of every dimension if all of them are cached under the key.
+ */
+bool ResultCache::findRows(const CacheFileKey& key, const bool digestFlag,
+    const vector<uint32_t>& normalizationSizes, vector<const HashRow*>& rows) const {
+    const unordered_map<string, const HashRow*>& entries = digestFlag ? digestEntries : identityEntries;
+    rows.clear();
+    for (const uint32_t normalizationSize : normalizationSizes) {
+        const auto entry = entries.find(formatKey(key, digestFlag, normalizationSize));
+        if (entry == entries.end()) return false;
+        rows.push_back(entry->second);
+    }
+    return true;
+}
+
+/*
+ * Looks up the hashes of a file at every supplied dimension (concatenated in
+ * order). The file identity is tried first; on a miss the content digest is
+ * computed and tried (a digest hit stores aliases of the rows under the new
+ * identity). The key is returned for storing results after a miss.
+ */
+bool ResultCache::lookup(const string& filename, const vector<uint32_t>& normalizationSizes,
+    vector<HashRow>& rows, CacheFileKey& key) {
+    struct stat fileStat;
+    if (stat(filename.c_str(), &fileStat)) throw "ResultCache Error: Failed to stat file.";
+    key = {(uint64_t) fileStat.st_dev, (uint64_t) fileStat.st_ino, (uint64_t) fileStat.st_size,
+        ((uint64_t) fileStat.st_mtim.tv_sec * 1000000000) + (uint64_t) fileStat.st_mtim.tv_nsec, 0};
+    vector<const HashRow*> storedRows;
+    {
+        lock_guard<mutex> cacheGuard(cacheLock);
+        if (findRows(key, false, normalizationSizes, storedRows)) {
+            identityHits++;
+            copyRows(storedRows, normalizationSizes, rows);
+            return true;
+        }
+    }
+
+    // fall back to content digest (touched, copied or moved files)
+    key.digest = computeContentDigest(filename);
+    {
+        lock_guard<mutex> cacheGuard(cacheLock);
+        if (!findRows(key, true, normalizationSizes, storedRows)) {
+            misses++;
+            return false;
+        }
+        digestHits++;
+        copyRows(storedRows, normalizationSizes, rows);
+    }
+    vector<ResultCacheEntry> entries;
+    for (const uint32_t normalizationSize : normalizationSizes) {
+        entries.push_back(buildEntry(key, normalizationSize, CACHE_ENTRY_ALIAS));
+    }
+    appendEntries(entries, storedRows);
+    return true;
+}
+
+/*
+ * Appends hash rows of one dimension under a key returned by lookup.
+ */
+void ResultCache::store(const CacheFileKey& key, const uint32_t normalizationSize, const HashRow* rows) {
+    if (!key.digest) throw "ResultCache Error: Key has no content digest.";
+    if (!getEntryRowCount(normalizationSize)) throw "ResultCache Error: Invalid normalization dimension.";
+    appendEntries({buildEntry(key, normalizationSize, 0)}, {rows});
+}
+
+/*
+ * Returns hit, miss and store counters.
+ */
+CacheStats ResultCache::getStats(void) const {
+    lock_guard<mutex> cacheGuard(cacheLock);
+    return {identityHits, digestHits, misses, storedEntries};
+}
+
+/*
+ * Returns number of distinct file identities and dimensions held.
+ */
+size_t ResultCache::getEntryCount(void) const {
+    lock_guard<mutex> cacheGuard(cacheLock);
+    return identityEntries.size();
+}
+
+/*
+ * Unmaps and closes cache file (every entry is already written).
+ */
+ResultCache::~ResultCache(void) {
+    unmapEntries();
+    close(fileDescriptor);
+}
@@ -0,0 +1,308 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "store/hashdb.h"
+using namespace std;
+
+#define SIDE_TABLE_SUFFIX ".paths"
+
+static const char databaseMagic[8] = {'P', 'D', 'H', 'A', 'S', 'H', 'D', 'B'};
+
+/*
+ * CRC-32 (IEEE 802.3) lookup table.
+ */
+static struct CRCTable {
+    uint32_t entries[256];
+    CRCTable(void) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (uint32_t j = 0; j < 8; j++) crc = (crc >> 1) ^ ((crc & 0x1) ? 0xEDB88320 : 0);
+            entries[i] = crc;
+        }
+    }
+} crcTable;
+
+/*
+ * Computes CRC-32 checksum of supplied bytes.
+ */
+uint32_t HashDatabase::computeChecksum(const void* data, const size_t size) {
+    const uint8_t* bytes = (const uint8_t*) data;
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; i++) crc = crcTable.entries[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+/*
+ * Returns record size of a channel set. The full set stores whole hash rows
+ * (mapped zero-copy); subsets pack only their channel words.
+ */
+static uint32_t computeRecordSize(const uint32_t rowCount, const uint32_t channelMask) {
+    if (channelMask == ALL_CHANNELS_MASK) return rowCount * sizeof(HashRow);
+    return rowCount * __builtin_popcount(channelMask) * sizeof(uint64_t);
+}
+
+/*
+ * Creates empty database (and side table) for the supplied hash parameters.
+ */
+void HashDatabase::create(const string& path, const uint32_t normalizationDimension, 
+    const uint32_t channelMask) {
+    const uint32_t rowCount = (normalizationDimension * normalizationDimension) / HASH_SEGMENT_SIZE;
+    if (!rowCount) throw "HashDatabase Error: Invalid normalization dimension.";
+    if (!channelMask || (channelMask & ~ALL_CHANNELS_MASK)) throw "HashDatabase Error: Invalid channel set.";
+
+    // build header
+    HashDatabaseHeader header;
+    memset(&header, 0, sizeof(HashDatabaseHeader));
+    memcpy(header.magic, databaseMagic, sizeof(databaseMagic));
+    header.version = HASH_DATABASE_VERSION;
+    header.normalizationDimension = normalizationDimension;
+    header.channelMask = channelMask;
+    header.rowCount = rowCount;
+    header.recordSize = computeRecordSize(rowCount, channelMask);
+    header.headerChecksum = computeChecksum(&header, sizeof(HashDatabaseHeader));
+
+    // write new files
+    const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) throw "HashDatabase Error: Failed to create database.";
+    const bool written = write(fd, &header, sizeof(HashDatabaseHeader)) == sizeof(HashDatabaseHeader);
+    close(fd);
+    if (!written) throw "HashDatabase Error: Failed to write header.";
+    FILE* sideTable = fopen((path + SIDE_TABLE_SUFFIX).c_str(), "w");
+    if (sideTable == nullptr) throw "HashDatabase Error: Failed to create side table.";
+    fclose(sideTable);
+}
+
+/*
+ * Opens existing database, validates its header and maps the records.
+ */
+HashDatabase::HashDatabase(const string& path, const bool writable) : path(path), 
+    writable(writable), fileDescriptor(-1), sideTable(nullptr), mappedData(nullptr), 
+    mappedSize(0), mappedRecordCount(0), entries(nullptr), unpackedRows(nullptr) {
+    fileDescriptor = open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (fileDescriptor < 0) throw "HashDatabase Error: Failed to open database.";
+
+    // validate header
+    struct stat fileStat;
+    if (fstat(fileDescriptor, &fileStat) || (pread(fileDescriptor, &header, sizeof(HashDatabaseHeader), 0) 
+        != sizeof(HashDatabaseHeader))) {
+        close(fileDescriptor);
+        throw "HashDatabase Error: Failed to read header.";
+    }
+    HashDatabaseHeader unsignedHeader = header;
+    unsignedHeader.headerChecksum = 0;
+    if (memcmp(header.magic, databaseMagic, sizeof(databaseMagic)) || 
+        (header.version != HASH_DATABASE_VERSION) || 
+        (header.headerChecksum != computeChecksum(&unsignedHeader, sizeof(HashDatabaseHeader))) ||
+        !header.channelMask || (header.channelMask & ~ALL_CHANNELS_MASK) ||
+        (header.recordSize != computeRecordSize(header.rowCount, header.channelMask)) ||
+        ((size_t) fileStat.st_size < HASH_DATABASE_HEADER_SIZE + (header.recordCount * header.recordSize))) {
+        close(fileDescriptor);
+        throw "HashDatabase Error: Invalid or corrupt database header.";
+    }
+
+    // drop partially appended records and open side table for appending
+    if (writable) {
+        if (ftruncate(fileDescriptor, HASH_DATABASE_HEADER_SIZE + (header.recordCount * header.recordSize))) {
+            close(fileDescriptor);
+            throw "HashDatabase Error: Failed to truncate database.";
+        }
+        sideTable = fopen((path + SIDE_TABLE_SUFFIX).c_str(), "a");
+        if (sideTable == nullptr) {
+            close(fileDescriptor);
+            throw "HashDatabase Error: Failed to open side table.";
+        }
+    }
+    try {
+        mapRecords();
+    }
+    catch (const char*) {
+        if (sideTable != nullptr) fclose(sideTable);
+        close(fileDescriptor);
+        throw;
+    }
+}
+
+/*
+ * Maps header and all committed records (zero-copy record access).
+ */
+void HashDatabase::mapRecords(void) {
+    unmapRecords();
+    mappedSize = HASH_DATABASE_HEADER_SIZE + (header.recordCount * header.recordSize);
+    void* data = mmap(nullptr, mappedSize, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+    if (data == MAP_FAILED) {
+        mappedSize = 0;
+        throw "HashDatabase Error: Failed to map database.";
+    }
+    mappedData = (uint8_t*) data;
+    mappedRecordCount = header.recordCount;
+}
+
+/*
+ * Unpacks channel-subset records appended since the last call into whole
+ * hash rows (unstored channels stay zero).
+ */
+void HashDatabase::unpackRecords(void) {
+    if (unpackedRows == nullptr) unpackedRows.reset(new vector<HashRow>());
+    if ((*unpackedRows).size() == (header.recordCount * header.rowCount)) return;
+    if (mappedRecordCount < header.recordCount) mapRecords();
+    const uint64_t firstRecord = (*unpackedRows).size() / header.rowCount;
+    (*unpackedRows).resize(header.recordCount * header.rowCount, HashRow());
+    for (uint64_t i = firstRecord; i < header.recordCount; i++) {
+        const uint64_t* words = (const uint64_t*) (mappedData + HASH_DATABASE_HEADER_SIZE + 
+            (i * header.recordSize));
+        for (uint32_t r = 0; r < header.rowCount; r++) {
+            HashRow& row = (*unpackedRows)[(i * header.rowCount) + r];
+            for (uint32_t c = 0; c < HASH_CHANNEL_COUNT; c++) 
+                if (header.channelMask & (0x1 << c)) row.channelData[c] = *(words++);
+        }
+    }
+}
+
+/*
+ * Releases record mapping.
+ */
+void HashDatabase::unmapRecords(void) {
+    if (mappedData != nullptr) munmap(mappedData, mappedSize);
+    mappedData = nullptr;
+    mappedSize = 0;
+    mappedRecordCount = 0;
+}
+
+/*
+ * Loads image paths and record checksums. Later lines override earlier ones
+ * and lines past the committed record count are ignored.
+ */
+void HashDatabase::loadSideTable(void) {
+    entries.reset(new vector<HashDatabaseEntry>(header.recordCount));
+    FILE* table = fopen((path + SIDE_TABLE_SUFFIX).c_str(), "r");
+    if (table == nullptr) throw "HashDatabase Error: Failed to open side table.";
+    char* line = nullptr;
+    size_t capacity = 0;
+    ssize_t length;
+    while ((length = getline(&line, &capacity, table)) > 0) {
+        if (line[length - 1] == '\n') line[--length] = '\0';
+        char* checksumField = strchr(line, '\t');
+        char* pathField = checksumField ? strchr(checksumField + 1, '\t') : nullptr;
+        if (pathField == nullptr) continue;
+        const uint64_t imageId = strtoull(line, nullptr, 10);
+        if (imageId >= header.recordCount) continue;
+        (*entries)[imageId] = {(uint32_t) strtoul(checksumField + 1, nullptr, 16), string(pathField + 1)};
+    }
+    free(line);
+    fclose(table);
+}
+
+/*
+ * Rewrites header with current record count and checksum.
+ */
+void HashDatabase::writeHeader(void) {
+    header.headerChecksum = 0;
+    header.headerChecksum = computeChecksum(&header, sizeof(HashDatabaseHeader));
+    if (pwrite(fileDescriptor, &header, sizeof(HashDatabaseHeader), 0) != sizeof(HashDatabaseHeader))
+        throw "HashDatabase Error: Failed to write header.";
+}
+
+/*
+ * Appends hash record (only the stored channels) and its image path. Rows
+ * and path are written before the header count, so a process interrupted
+ * mid-append leaves the record invisible. Nothing is synced, so after power
+ * loss the header may reach disk before the record.
+ */
+uint64_t HashDatabase::append(const HashRow* rows, const string& imagePath) {
+    if (!writable) throw "HashDatabase Error: Database opened read-only.";
+    if (imagePath.find_first_of("\t\n") != string::npos) throw "HashDatabase Error: Invalid image path.";
+    const uint64_t imageId = header.recordCount;
+
+    // pack channel-subset records
+    vector<uint64_t> packedWords;
+    const void* record = rows;
+    if (header.channelMask != ALL_CHANNELS_MASK) {
+        packedWords.reserve(header.recordSize / sizeof(uint64_t));
+        for (uint32_t r = 0; r < header.rowCount; r++) {
+            for (uint32_t c = 0; c < HASH_CHANNEL_COUNT; c++) 
+                if (header.channelMask & (0x1 << c)) packedWords.push_back(rows[r].channelData[c]);
+        }
+        record = packedWords.data();
+    }
+    const uint32_t checksum = computeChecksum(record, header.recordSize);
+
+    // write record and side table entry
+    const off_t offset = HASH_DATABASE_HEADER_SIZE + (imageId * header.recordSize);
+    if (pwrite(fileDescriptor, record, header.recordSize, offset) != (ssize_t) header.recordSize)
+        throw "HashDatabase Error: Failed to append record.";
+    fprintf(sideTable, "%lu\t%08x\t%s\n", (unsigned long) imageId, checksum, imagePath.c_str());
+    if (fflush(sideTable)) throw "HashDatabase Error: Failed to append side table.";
+
+    // commit record
+    header.recordCount++;
+    writeHeader();
+    if (entries != nullptr) (*entries).push_back({checksum, imagePath});
+    return imageId;
+}
+
+/*
+ * Returns rows of the indicated record: mapped for the full channel set,
+ * unpacked otherwise. Rows needing a remap (or unpack) after appends move, so
+ * an append invalidates every pointer returned earlier.
+ */
+const HashRow* HashDatabase::getHashRows(const uint64_t imageId) {
+    if (imageId >= header.recordCount) throw "HashDatabase Error: Invalid image id.";
+    if (header.channelMask != ALL_CHANNELS_MASK) {
+        unpackRecords();
+        return &(*unpackedRows)[imageId * header.rowCount];
+    }
+    if (imageId >= mappedRecordCount) mapRecords();
+    return (const HashRow*) (mappedData + HASH_DATABASE_HEADER_SIZE + (imageId * header.recordSize));
+}
+
+/*
+ * Returns contiguous records (rowCount rows each) for batch use, mapped or
+ * unpacked as getHashRows. An append invalidates the returned pointer.
+ */
+const HashRow* HashDatabase::getRecords(void) {
+    if (header.channelMask != ALL_CHANNELS_MASK) {
+        unpackRecords();
+        return (*unpackedRows).data();
+    }
+    if (mappedRecordCount < header.recordCount) mapRecords();
+    return (const HashRow*) (mappedData + HASH_DATABASE_HEADER_SIZE);
+}
+
+/*
+ * Returns image path of the indicated record.
+ */
+const string& HashDatabase::getImagePath(const uint64_t imageId) {
+    if (imageId >= header.recordCount) throw "HashDatabase Error: Invalid image id.";
+    if (entries == nullptr) loadSideTable();
+    return (*entries)[imageId].imagePath;
+}
+
+/*
+ * Checks every record against its side table checksum and returns the 
+ * number of corrupt records.
+ */
+size_t HashDatabase::verify(void) {
+    if (entries == nullptr) loadSideTable();
+    if (mappedRecordCount < header.recordCount) mapRecords();
+    size_t corruptCount = 0;
+    for (uint64_t i = 0; i < header.recordCount; i++) {
+        if (computeChecksum(mappedData + HASH_DATABASE_HEADER_SIZE + (i * header.recordSize), header.recordSize) != 
+            (*entries)[i].checksum) corruptCount++;
+    }
+    return corruptCount;
+}
+
+/*
+ * Unmaps records and closes files.
+ */
+HashDatabase::~HashDatabase(void) {
+    unmapRecords();
+    if (sideTable != nullptr) fclose(sideTable);
+    if (fileDescriptor >= 0) close(fileDescriptor);
+    entries.reset(nullptr);
+    unpackedRows.reset(nullptr);
+}
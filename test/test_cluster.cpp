@@ -0,0 +1,86 @@
+#include <iostream>
+#include <random>
+#include <vector>
+#include <numeric>
+#include <limits>
+#include "hash/engine.h"
+#include "index/cluster.h"
+using namespace std;
+
+#define TEST_HASH_COUNT 2500
+#define TEST_ROW_COUNT 16
+
+/*
+ * Returns root of a serial union-find forest (halving paths).
+ */
+static uint32_t findRoot(vector<uint32_t>& parents, uint32_t hashId) {
+    while (parents[hashId] != hashId) hashId = parents[hashId] = parents[parents[hashId]];
+    return hashId;
+}
+
+/*
+ * Clusters hashes by comparing every pair serially and numbers clusters by
+ * first member, as HashClusterer does.
+ */
+static vector<uint32_t> clusterPairs(const vector<HashRow>& hashes, const uint32_t distance) {
+    vector<uint32_t> parents(TEST_HASH_COUNT);
+    iota(parents.begin(), parents.end(), 0);
+    for (size_t i = 0; i < TEST_HASH_COUNT; i++) {
+        for (size_t j = i + 1; j < TEST_HASH_COUNT; j++) {
+            if (computeChannelDistance(&hashes[i * TEST_ROW_COUNT], &hashes[j * TEST_ROW_COUNT],
+                TEST_ROW_COUNT, LUMINANCE_CHANNEL) > distance) continue;
+            const uint32_t root1 = findRoot(parents, i), root2 = findRoot(parents, j);
+            parents[max(root1, root2)] = min(root1, root2);
+        }
+    }
+    vector<uint32_t> clusterIds(TEST_HASH_COUNT), rootIds(TEST_HASH_COUNT, numeric_limits<uint32_t>::max());
+    uint32_t clusterCount = 0;
+    for (size_t i = 0; i < TEST_HASH_COUNT; i++) {
+        const uint32_t root = findRoot(parents, i);
+        if (rootIds[root] == numeric_limits<uint32_t>::max()) rootIds[root] = clusterCount++;
+        clusterIds[i] = rootIds[root];
+    }
+    return clusterIds;
+}
+
+/*
+ * Checks concurrent clustering at several distances and thread counts
+ * against a serial all-pairs union-find. A third of the hashes are bit flips
+ * of earlier ones, so clusters chain across tiles.
+ */
+int main(void) {
+    mt19937_64 random(3);
+    vector<HashRow> hashes(TEST_HASH_COUNT * TEST_ROW_COUNT);
+    for (size_t id = 0; id < TEST_HASH_COUNT; id++) {
+        HashRow* rows = &hashes[id * TEST_ROW_COUNT];
+        if (id && !(random() % 3)) {
+            const HashRow* source = &hashes[(random() % id) * TEST_ROW_COUNT];
+            for (uint32_t r = 0; r < TEST_ROW_COUNT; r++) rows[r] = source[r];
+            for (uint32_t f = random() % 80; f > 0; f--) {
+                const uint32_t bit = random() % (TEST_ROW_COUNT * HASH_SEGMENT_SIZE);
+                rows[bit / HASH_SEGMENT_SIZE].channelData[LUMINANCE_CHANNEL] ^= 
+                    uint64_t(0x1) << (bit % HASH_SEGMENT_SIZE);
+            }
+        }
+        else {
+            for (uint32_t r = 0; r < TEST_ROW_COUNT; r++) {
+                for (uint32_t c = 0; c < HASH_CHANNEL_COUNT; c++) rows[r].channelData[c] = random();
+            }
+        }
+    }
+
+    // cluster at every distance and thread count
+    size_t failures = 0, checks = 0;
+    for (const uint32_t distance : {0u, 40u, 100u, 400u}) {
+        const vector<uint32_t> expected = clusterPairs(hashes, distance);
+        for (const size_t threadCount : {(size_t) 1, (size_t) 2, (size_t) 4, (size_t) 7}) {
+            HashClusterer clusterer(hashes.data(), TEST_HASH_COUNT, TEST_ROW_COUNT, LUMINANCE_CHANNEL, threadCount);
+            clusterer.cluster(distance);
+            failures += (clusterer.getClusterIds() != expected);
+            checks++;
+        }
+    }
+    cout << "test_cluster: " << (checks - failures) << " of " << checks << " clusterings matched serial union-find."
+        << endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,86 @@
+#include <iostream>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include "index/hindex.h"
+using namespace std;
+
+#define TEST_HASH_COUNT 3000
+#define TEST_QUERY_COUNT 50
+
+/*
+ * Returns every stored hash within radius of the query by linear scan,
+ * ordered by distance then id.
+ */
+static vector<HammingMatch> scanRadius(const vector<HashRow>& hashes, const HashRow* query, 
+    const uint32_t rowCount, const uint32_t radius) {
+    vector<HammingMatch> matches;
+    for (size_t id = 0; id < (hashes.size() / rowCount); id++) {
+        const uint32_t distance = computeChannelDistance(query, &hashes[id * rowCount], rowCount, 
+            LUMINANCE_CHANNEL);
+        if (distance <= radius) matches.push_back({uint32_t(id), distance});
+    }
+    sort(matches.begin(), matches.end(), [](const HammingMatch& m1, const HammingMatch& m2) {
+        return (m1.distance < m2.distance) || ((m1.distance == m2.distance) && (m1.hashId < m2.hashId)); });
+    return matches;
+}
+
+/*
+ * Returns whether two match lists hold the same ids at the same distances.
+ */
+static bool compareResults(const vector<HammingMatch>& found, const vector<HammingMatch>& expected) {
+    if (found.size() != expected.size()) return false;
+    for (size_t i = 0; i < found.size(); i++) {
+        if ((found[i].hashId != expected[i].hashId) || (found[i].distance != expected[i].distance)) return false;
+    }
+    return true;
+}
+
+/*
+ * Checks radius and k-NN queries of every substring size (bulk built and
+ * incrementally inserted) against a linear scan. Hashes are random or bit
+ * flips of shared seeds, so queries see both near and distant neighbours.
+ */
+int main(void) {
+    const uint32_t rowCount = DEFAULT_HASH_ROW_COUNT;
+    mt19937_64 random(42);
+    vector<HashRow> seeds(16 * rowCount), hashes(TEST_HASH_COUNT * rowCount);
+    for (HashRow& row : seeds) row.channelData[LUMINANCE_CHANNEL] = random();
+    for (size_t id = 0; id < TEST_HASH_COUNT; id++) {
+        const size_t seed = random() % 16;
+        for (uint32_t r = 0; r < rowCount; r++) {
+            uint64_t word = (id % 3) ? seeds[(seed * rowCount) + r].channelData[LUMINANCE_CHANNEL] : random();
+            for (uint32_t f = random() % 4; f > 0; f--) word ^= uint64_t(0x1) << (random() % 64);
+            hashes[(id * rowCount) + r].channelData[LUMINANCE_CHANNEL] = word;
+        }
+    }
+
+    // query bulk-built and inserted indexes at every substring size
+    size_t failures = 0, checks = 0;
+    for (const uint32_t substringBits : {8u, 16u, 32u}) {
+        HammingIndex builtIndex(rowCount, LUMINANCE_CHANNEL, substringBits);
+        HammingIndex insertedIndex(rowCount, LUMINANCE_CHANNEL, substringBits);
+        builtIndex.build(hashes.data(), TEST_HASH_COUNT);
+        for (size_t id = 0; id < TEST_HASH_COUNT; id++) insertedIndex.insert(&hashes[id * rowCount]);
+        for (const HammingIndex* index : {&builtIndex, &insertedIndex}) {
+            for (size_t q = 0; q < TEST_QUERY_COUNT; q++) {
+                const HashRow* query = &hashes[(random() % TEST_HASH_COUNT) * rowCount];
+                vector<HammingMatch> found;
+                for (const uint32_t radius : {0u, 16u, 64u, 200u, 600u}) {
+                    index->radiusQuery(query, radius, found);
+                    failures += !compareResults(found, scanRadius(hashes, query, rowCount, radius));
+                    checks++;
+                }
+                for (const size_t k : {(size_t) 1, (size_t) 10, (size_t) 500}) {
+                    index->nearestQuery(query, k, found);
+                    vector<HammingMatch> expected = scanRadius(hashes, query, rowCount, UINT32_MAX);
+                    expected.resize(min(k, expected.size()));
+                    failures += !compareResults(found, expected);
+                    checks++;
+                }
+            }
+        }
+    }
+    cout << "test_hindex: " << (checks - failures) << " of " << checks << " queries matched linear scan." << endl;
+    return failures ? 1 : 0;
+}
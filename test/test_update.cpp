@@ -0,0 +1,92 @@
+#include <iostream>
+#include <random>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <string.h>
+#include "pimg/grid.h"
+#include "pimg/integral.h"
+#include "hash/phash.h"
+using namespace std;
+
+#define TEST_GRID_HEIGHT 333
+#define TEST_GRID_WIDTH 257
+#define TEST_EDIT_ROUNDS 300
+
+/*
+ * Returns whether an updated hash equals a full hash of the current grid.
+ */
+static bool compareFullHash(const PixelGrid& grid, const ImagePerceptualHash& updatedHash) {
+    ImagePerceptualHash fullHash(grid, updatedHash.getNormalizationDimension());
+    fullHash.executeHash();
+    return !memcmp(fullHash.getHashRows(), updatedHash.getHashRows(),
+        sizeof(HashRow) * updatedHash.getHashRowCount());
+}
+
+/*
+ * Applies random edits to a gradient grid and checks every update of hashes
+ * at several dimensions (first hashed directly and from summed-area tables)
+ * against a full re-hash. Edits are small rectangles through setPixel, raw
+ * row writes marked dirty, and half-image overwrites that move the mean.
+ * The grid's edit log must stay within two entries per tile.
+ */
+int main(void) {
+    mt19937_64 random(7);
+    PixelGrid grid({TEST_GRID_HEIGHT, TEST_GRID_WIDTH});
+    for (size_t i = 0; i < TEST_GRID_HEIGHT; i++) {
+        GridPixel* pixels = grid.getRow(i);
+        for (size_t j = 0; j < TEST_GRID_WIDTH; j++) {
+            pixels[j] = {uint8_t(((j * 255) / TEST_GRID_WIDTH) ^ (random() & 0xF)),
+                uint8_t(((i * 255) / TEST_GRID_HEIGHT) ^ (random() & 0xF)), uint8_t(random()), 0};
+        }
+    }
+
+    // hash every dimension directly and from summed-area tables
+    vector<unique_ptr<ImagePerceptualHash>> hashes;
+    IntegralGrid integralGrid(grid);
+    for (const uint32_t dimension : {16u, 32u, 64u}) {
+        hashes.emplace_back(new ImagePerceptualHash(grid, dimension));
+        hashes.back()->executeHash();
+        hashes.emplace_back(new ImagePerceptualHash(grid, dimension));
+        hashes.back()->executeHash(integralGrid);
+    }
+
+    // edit, update and compare against full hashes
+    size_t failures = 0, checks = 0;
+    for (size_t round = 0; round < TEST_EDIT_ROUNDS; round++) {
+        const size_t height = 1 + (random() % 40), width = 1 + (random() % 40);
+        const size_t top = random() % (TEST_GRID_HEIGHT - height), left = random() % (TEST_GRID_WIDTH - width);
+        const uint8_t value = random();
+        if ((round % 3) == 0) {
+            for (size_t i = 0; i < height; i++) {
+                for (size_t j = 0; j < width; j++) {
+                    grid.setPixel({uint32_t(top + i + 1), uint32_t(left + j + 1)},
+                        {value, uint8_t(255 - value), uint8_t(value / 2), 0});
+                }
+            }
+        }
+        else if ((round % 3) == 1) {
+            for (size_t i = 0; i < height; i++) {
+                for (size_t j = 0; j < width; j++) grid.getRow(top + i)[left + j] = {value, value, value, 0};
+            }
+            grid.markDirty(top, left, height, width);
+        }
+        else {
+            vector<uint8_t> row(TEST_GRID_WIDTH * 3, value);
+            for (size_t i = random() % 2; i < TEST_GRID_HEIGHT; i += 2) grid.setPixelRow(i + 1, row.data());
+        }
+        for (unique_ptr<ImagePerceptualHash>& hash : hashes) {
+            hash->updateHash();
+            failures += !compareFullHash(grid, *hash);
+            checks++;
+        }
+    }
+
+    // edit log stays bounded by the tiles edited, not the edits made
+    const size_t tileCount = grid.getDirtyTileColumns() * 
+        ((TEST_GRID_HEIGHT + DIRTY_TILE_SIZE - 1) / DIRTY_TILE_SIZE);
+    const bool boundedFlag = grid.getDirtyLogSize() <= max((size_t) MIN_DIRTY_LOG_COMPACTION, 2 * tileCount);
+    cout << "test_update: " << (checks - failures) << " of " << checks << " updates matched full re-hash, "
+        << grid.getDirtyLogSize() << " edit log entries held." << endl;
+    return (failures || !boundedFlag) ? 1 : 0;
+}